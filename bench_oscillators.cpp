@@ -0,0 +1,158 @@
+// Compares the cost per voice-sample of the band-limited oscillators against
+// the naive shapes they replaced, the cost of the per-voice filter and the
+// cost of each oversampling factor.
+// Build: clang++ -std=c++17 -O2 -Isrc bench_oscillators.cpp src/oversampler.cpp -o bench_oscillators
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include "oversampler.h"
+#include "simd.h"
+#include "voice_kernels.h"
+
+using namespace simd_generic;
+using namespace voice_kernels;
+
+using S = SimdNative;
+
+static constexpr int VOICES = 16;
+
+// Lane storage for the benchmark voices
+struct BenchLanes {
+    alignas(64) uint32_t phase[VOICES] = {};
+    alignas(64) uint32_t phase_increment[VOICES] = {};
+    alignas(64) uint32_t phase_increment_step[VOICES] = {};
+    alignas(64) float env_level[VOICES] = {};
+    alignas(64) float env_increment[VOICES] = {};
+    alignas(64) float gain[VOICES] = {};
+    alignas(64) int32_t waveform[VOICES] = {};
+    alignas(64) float filter_ic1[VOICES] = {};
+    alignas(64) float filter_ic2[VOICES] = {};
+    alignas(64) float filter_a1[VOICES] = {};
+    alignas(64) float filter_a2[VOICES] = {};
+    alignas(64) float filter_a3[VOICES] = {};
+    alignas(64) float filter_a1_step[VOICES] = {};
+    alignas(64) float filter_a2_step[VOICES] = {};
+    alignas(64) float filter_a3_step[VOICES] = {};
+};
+
+template <class Osc, bool Filter = false>
+static double ns_per_sample(VoiceLanes& lanes, const Osc& osc) {
+    const uint32_t n = VoiceLanes::MAX_CHUNK;
+    const int chunks = 20000;
+    alignas(64) float acc[VoiceLanes::MAX_CHUNK * S::width] = {};
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < chunks; ++c) {
+        for (int g = 0; g < VOICES; g += S::width) {
+            render_group<S, false, Filter>(lanes, g, acc, n, osc);
+        }
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    // Keep the result alive
+    volatile float sink = acc[0];
+    (void)sink;
+
+    const double samples = static_cast<double>(chunks) * n * VOICES;
+    return std::chrono::duration<double, std::nano>(end - start).count() / samples;
+}
+
+// Cost per host-rate voice-sample with the voices rendered at the
+// oversampler's factor, decimation included
+static double ns_per_output_sample(VoiceLanes& lanes, Oversampler& oversampler) {
+    const uint32_t n = 64;
+    const int blocks = 2000;
+    const uint32_t factor = static_cast<uint32_t>(oversampler.factor());
+    alignas(64) float out[n];
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int b = 0; b < blocks; ++b) {
+        float* buffer = factor > 1 ? oversampler.buffer() : out;
+        std::memset(buffer, 0, n * factor * sizeof(float));
+        for (uint32_t i = 0; i < n * factor; i += VoiceLanes::MAX_CHUNK) {
+            render_lanes<S>(lanes, VOICES, buffer + i, VoiceLanes::MAX_CHUNK);
+        }
+        if (factor > 1) {
+            oversampler.decimate(out, n);
+        }
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    volatile float sink = out[0];
+    (void)sink;
+
+    const double samples = static_cast<double>(blocks) * n * VOICES;
+    return std::chrono::duration<double, std::nano>(end - start).count() / samples;
+}
+
+static void report(const char* name, double naive, double band_limited) {
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << naive << std::setw(14) << band_limited
+              << std::setw(9) << band_limited / naive << "x" << std::endl;
+}
+
+int main() {
+    BenchLanes storage;
+    VoiceLanes lanes;
+    lanes.phase = storage.phase;
+    lanes.phase_increment = storage.phase_increment;
+    lanes.phase_increment_step = storage.phase_increment_step;
+    lanes.env_level = storage.env_level;
+    lanes.env_increment = storage.env_increment;
+    lanes.gain = storage.gain;
+    lanes.waveform = storage.waveform;
+    lanes.filter_ic1 = storage.filter_ic1;
+    lanes.filter_ic2 = storage.filter_ic2;
+    lanes.filter_a1 = storage.filter_a1;
+    lanes.filter_a2 = storage.filter_a2;
+    lanes.filter_a3 = storage.filter_a3;
+    lanes.filter_a1_step = storage.filter_a1_step;
+    lanes.filter_a2_step = storage.filter_a2_step;
+    lanes.filter_a3_step = storage.filter_a3_step;
+    for (int i = 0; i < VOICES; ++i) {
+        lanes.phase_increment[i] = static_cast<uint32_t>(440.0 * (1.0 + 0.37 * i) / 48000.0 * 4294967296.0);
+        lanes.env_level[i] = 0.7f;
+        lanes.gain[i] = 0.8f;
+        // 2 kHz cutoff at 48 kHz, moderate resonance
+        lanes.filter_a1[i] = 0.831f;
+        lanes.filter_a2[i] = 0.1094f;
+        lanes.filter_a3[i] = 0.0144f;
+    }
+
+    std::cout << "ns per voice-sample, " << S::width << " lanes per instruction" << std::endl;
+    std::cout << "shape          naive  band-limited    ratio" << std::endl;
+    report("Square", ns_per_sample(lanes, NaiveSquare<S>()), ns_per_sample(lanes, Square<S>()));
+    report("Saw", ns_per_sample(lanes, NaiveSaw<S>()), ns_per_sample(lanes, Saw<S>()));
+    report("Triangle", ns_per_sample(lanes, NaiveTriangle<S>()), ns_per_sample(lanes, Triangle<S>()));
+    report("Pulse", ns_per_sample(lanes, NaivePulse<S>()), ns_per_sample(lanes, Pulse<S>()));
+
+    std::cout << std::endl << "shape       unfiltered      filtered    ratio" << std::endl;
+    report("Saw", ns_per_sample(lanes, Saw<S>()), ns_per_sample<Saw<S>, true>(lanes, Saw<S>()));
+
+    // Filtered saws, per quality
+    for (int i = 0; i < VOICES; ++i) {
+        lanes.waveform[i] = WAVE_SAW;
+    }
+    std::cout << std::endl << "factor         low    medium      high    medium vs 1x (filtered saw)" << std::endl;
+    double base = 0.0;
+    for (int factor = 1; factor <= Oversampler::MAX_FACTOR; factor *= 2) {
+        Oversampler oversampler;
+        oversampler.set_factor(factor, 64);
+        std::cout << std::setw(5) << factor << "x" << std::fixed << std::setprecision(3);
+        double medium = 0.0;
+        for (int quality = 0; quality < Oversampler::QUALITY_COUNT; ++quality) {
+            oversampler.set_quality(quality);
+            const double ns = ns_per_output_sample(lanes, oversampler);
+            if (quality == Oversampler::QUALITY_MEDIUM) {
+                medium = ns;
+            }
+            std::cout << std::setw(10) << ns;
+        }
+        if (factor == 1) {
+            base = medium;
+        }
+        std::cout << std::setw(15) << std::setprecision(2) << medium / base << "x" << std::endl;
+    }
+    return 0;
+}
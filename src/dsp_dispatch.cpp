@@ -0,0 +1,99 @@
+#include "dsp_dispatch.h"
+
+#if defined(SIMPLE_SYNTH_X86_KERNELS) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#elif defined(SIMPLE_SYNTH_X86_KERNELS) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+extern const DspKernels dsp_kernels_generic;
+#if defined(SIMPLE_SYNTH_X86_KERNELS)
+extern const DspKernels dsp_kernels_avx2;
+extern const DspKernels dsp_kernels_avx512;
+#endif
+
+namespace {
+
+const DspKernels* selected_kernels = &dsp_kernels_generic;
+
+#if defined(SIMPLE_SYNTH_X86_KERNELS)
+struct CpuFeatures {
+    bool avx2;
+    bool avx512f;
+};
+
+void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; ++i) {
+        regs[i] = static_cast<uint32_t>(info[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+uint64_t xgetbv0() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+CpuFeatures detect_cpu_features() {
+    CpuFeatures features = {false, false};
+    uint32_t regs[4];
+
+    cpuid(0, 0, regs);
+    const uint32_t max_leaf = regs[0];
+    if (max_leaf < 7) {
+        return features;
+    }
+
+    // The OS has to save the wider registers on context switch, not just
+    // the CPU support them
+    cpuid(1, 0, regs);
+    const bool osxsave = (regs[2] & (1u << 27)) != 0;
+    const bool avx = (regs[2] & (1u << 28)) != 0;
+    // Both kernel TUs are built with -mfma, and some VMs report AVX2
+    // without it
+    const bool fma = (regs[2] & (1u << 12)) != 0;
+    if (!osxsave || !avx || !fma) {
+        return features;
+    }
+    const uint64_t xcr0 = xgetbv0();
+    const bool os_avx = (xcr0 & 0x6) == 0x6;        // XMM and YMM state
+    const bool os_avx512 = (xcr0 & 0xE6) == 0xE6;   // plus opmask and ZMM state
+
+    cpuid(7, 0, regs);
+    features.avx2 = os_avx && (regs[1] & (1u << 5)) != 0;
+    features.avx512f = os_avx512 && (regs[1] & (1u << 16)) != 0;
+    return features;
+}
+#endif
+
+} // namespace
+
+void select_dsp_kernels() {
+#if defined(SIMPLE_SYNTH_X86_KERNELS)
+    const CpuFeatures features = detect_cpu_features();
+    if (features.avx512f) {
+        selected_kernels = &dsp_kernels_avx512;
+    } else if (features.avx2) {
+        selected_kernels = &dsp_kernels_avx2;
+    } else {
+        selected_kernels = &dsp_kernels_generic;
+    }
+#else
+    selected_kernels = &dsp_kernels_generic;
+#endif
+}
+
+const DspKernels& dsp_kernels() {
+    return *selected_kernels;
+}
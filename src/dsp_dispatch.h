@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+struct VoiceLanes;
+
+// DSP kernels built for one instruction set level
+struct DspKernels {
+    const char* name;
+
+    // Render lane_count voice lanes for n <= VoiceLanes::MAX_CHUNK frames
+    // and accumulate the sum of all voices into out
+    void (*render_voices)(VoiceLanes& lanes, int lane_count, float* out, uint32_t n);
+
+    // Scale the mono voice sum by a gain ramping linearly from gain by
+    // gain_increment per frame and write it to both output channels
+    void (*mix_stereo)(const float* in, float gain, float gain_increment,
+                       float* left, float* right, uint32_t n);
+};
+
+// Pick the best kernels the CPU supports. Called once from clap_entry.init,
+// before any plugin instance exists; until then the baseline set is used.
+void select_dsp_kernels();
+
+const DspKernels& dsp_kernels();
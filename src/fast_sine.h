@@ -0,0 +1,28 @@
+#pragma once
+
+// sin(2*pi*phase) for phase in [0, 1], written against the Simd* wrappers so
+// the scalar and vector kernels share one implementation.
+//
+// The phase is shifted to u = phase - 0.5 (so sin(2*pi*phase) = -sin(2*pi*u))
+// and folded into [-0.25, 0.25] using sin(2*pi*u) = sin(2*pi*(+-0.5 - u)),
+// which only needs min/max. An odd degree-9 minimax polynomial covers the
+// folded quarter period. Error bound against std::sin: 1.3e-8 for the
+// polynomial itself, under 3e-7 including float rounding (checked by
+// test_fast_sine.cpp).
+template <class S>
+typename S::V fast_sine(typename S::V phase) {
+    using V = typename S::V;
+
+    const V u = S::sub(phase, S::set1(0.5f));
+    V x = S::min(u, S::sub(S::set1(0.5f), u));
+    x = S::max(x, S::sub(S::set1(-0.5f), u));
+
+    // Coefficients of -sin(2*pi*x), fitted on [-0.25, 0.25]
+    const V x2 = S::mul(x, x);
+    V p = S::set1(-39.87340714f);
+    p = S::add(S::mul(p, x2), S::set1(76.59823234f));
+    p = S::add(S::mul(p, x2), S::set1(-81.60326684f));
+    p = S::add(S::mul(p, x2), S::set1(41.34169188f));
+    p = S::add(S::mul(p, x2), S::set1(-6.283185302f));
+    return S::mul(p, x);
+}
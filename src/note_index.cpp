@@ -0,0 +1,144 @@
+#include "note_index.h"
+
+NoteIndex::NoteIndex() {
+    clear();
+}
+
+void NoteIndex::clear() {
+    for (int slot = 0; slot < MAX_SLOTS; ++slot) {
+        keys_[slot] = NoteKey();
+        used_[slot] = false;
+        next_[slot] = -1;
+        prev_[slot] = -1;
+    }
+    for (int16_t& head : heads_) {
+        head = -1;
+    }
+    for (int pos = 0; pos < ID_TABLE_SIZE; ++pos) {
+        ids_[pos] = -1;
+        id_slots_[pos] = -1;
+    }
+}
+
+void NoteIndex::insert(int slot, const NoteKey& key) {
+    remove(slot);
+
+    keys_[slot] = key;
+    used_[slot] = true;
+    link(slot);
+    if (key.note_id >= 0) {
+        insert_id(key.note_id, slot);
+    }
+}
+
+void NoteIndex::remove(int slot) {
+    if (!used_[slot]) {
+        return;
+    }
+
+    unlink(slot);
+    if (keys_[slot].note_id >= 0) {
+        erase_id(find_id(keys_[slot].note_id, slot));
+    }
+    keys_[slot] = NoteKey();
+    used_[slot] = false;
+}
+
+void NoteIndex::move(int from, int to) {
+    if (!used_[from]) {
+        return;
+    }
+
+    keys_[to] = keys_[from];
+    used_[to] = true;
+    used_[from] = false;
+
+    // Take over from's place in its list
+    if (has_bucket(keys_[to])) {
+        prev_[to] = prev_[from];
+        next_[to] = next_[from];
+        if (prev_[to] >= 0) {
+            next_[prev_[to]] = static_cast<int16_t>(to);
+        } else {
+            heads_[bucket(keys_[to])] = static_cast<int16_t>(to);
+        }
+        if (next_[to] >= 0) {
+            prev_[next_[to]] = static_cast<int16_t>(to);
+        }
+    }
+    next_[from] = -1;
+    prev_[from] = -1;
+
+    if (keys_[to].note_id >= 0) {
+        id_slots_[find_id(keys_[to].note_id, from)] = static_cast<int16_t>(to);
+    }
+    keys_[from] = NoteKey();
+}
+
+void NoteIndex::link(int slot) {
+    if (!has_bucket(keys_[slot])) {
+        return;
+    }
+
+    int16_t& head = heads_[bucket(keys_[slot])];
+    prev_[slot] = -1;
+    next_[slot] = head;
+    if (head >= 0) {
+        prev_[head] = static_cast<int16_t>(slot);
+    }
+    head = static_cast<int16_t>(slot);
+}
+
+void NoteIndex::unlink(int slot) {
+    if (!has_bucket(keys_[slot])) {
+        return;
+    }
+
+    if (prev_[slot] >= 0) {
+        next_[prev_[slot]] = next_[slot];
+    } else {
+        heads_[bucket(keys_[slot])] = next_[slot];
+    }
+    if (next_[slot] >= 0) {
+        prev_[next_[slot]] = prev_[slot];
+    }
+    next_[slot] = -1;
+    prev_[slot] = -1;
+}
+
+void NoteIndex::insert_id(int32_t note_id, int slot) {
+    // At most MAX_SLOTS entries in twice as many buckets, so there is
+    // always a free one
+    int pos = hash(note_id);
+    while (id_slots_[pos] >= 0) {
+        pos = (pos + 1) & ID_MASK;
+    }
+    ids_[pos] = note_id;
+    id_slots_[pos] = static_cast<int16_t>(slot);
+}
+
+int NoteIndex::find_id(int32_t note_id, int slot) const {
+    int pos = hash(note_id);
+    while (ids_[pos] != note_id || id_slots_[pos] != slot) {
+        pos = (pos + 1) & ID_MASK;
+    }
+    return pos;
+}
+
+void NoteIndex::erase_id(int pos) {
+    // Shift later entries of the probe run back so lookups never stop early
+    int hole = pos;
+    for (int next = (pos + 1) & ID_MASK; id_slots_[next] >= 0; next = (next + 1) & ID_MASK) {
+        const int home = hash(ids_[next]);
+        // Entries whose home lies cyclically in (hole, next] stay put
+        const bool stays = (hole <= next) ? (home > hole && home <= next)
+                                          : (home > hole || home <= next);
+        if (!stays) {
+            ids_[hole] = ids_[next];
+            id_slots_[hole] = id_slots_[next];
+            hole = next;
+        }
+    }
+    ids_[hole] = -1;
+    id_slots_[hole] = -1;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+
+// A note as CLAP addresses it. Any field set to -1 is a wildcard when the
+// key is used as a pattern.
+struct NoteKey {
+    int32_t note_id = -1;
+    int16_t port = -1;
+    int16_t channel = -1;
+    int16_t key = -1;
+
+    bool matches(const NoteKey& pattern) const {
+        return (pattern.note_id < 0 || pattern.note_id == note_id)
+            && (pattern.port < 0 || pattern.port == port)
+            && (pattern.channel < 0 || pattern.channel == channel)
+            && (pattern.key < 0 || pattern.key == key);
+    }
+};
+
+// Maps notes to the voice slots playing them, so note-offs and note
+// expressions find their voices without scanning the bank. Slots are linked
+// into one list per (channel, key) and note ids go through a small
+// open-addressing hash table. Everything is fixed size; nothing allocates.
+class NoteIndex {
+public:
+    static constexpr int MAX_SLOTS = 512;
+
+    NoteIndex();
+
+    void clear();
+
+    // Record that slot plays key, replacing whatever it played before
+    void insert(int slot, const NoteKey& key);
+    void remove(int slot);
+    // The voice in slot from now lives in slot to (which must be unused)
+    void move(int from, int to);
+
+    // Call f(slot) for every slot whose key matches pattern. Patterns with a
+    // note id or a channel and key are constant time; anything wider scans
+    // the first slot_count slots.
+    template <class F>
+    void for_each_match(const NoteKey& pattern, int slot_count, F f) const {
+        if (pattern.note_id >= 0) {
+            for (int pos = hash(pattern.note_id); id_slots_[pos] >= 0; pos = (pos + 1) & ID_MASK) {
+                const int slot = id_slots_[pos];
+                if (ids_[pos] == pattern.note_id && keys_[slot].matches(pattern)) {
+                    f(slot);
+                }
+            }
+        } else if (has_bucket(pattern)) {
+            for (int slot = heads_[bucket(pattern)]; slot >= 0; slot = next_[slot]) {
+                if (keys_[slot].matches(pattern)) {
+                    f(slot);
+                }
+            }
+        } else {
+            for (int slot = 0; slot < slot_count; ++slot) {
+                if (used_[slot] && keys_[slot].matches(pattern)) {
+                    f(slot);
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr int CHANNELS = 16;
+    static constexpr int KEYS = 128;
+    // Twice the slot count keeps the probe runs short
+    static constexpr int ID_BITS = 10;
+    static constexpr int ID_TABLE_SIZE = 1 << ID_BITS;
+    static constexpr int ID_MASK = ID_TABLE_SIZE - 1;
+    static_assert(ID_TABLE_SIZE >= 2 * MAX_SLOTS, "note id table too small");
+
+    NoteKey keys_[MAX_SLOTS];
+    bool used_[MAX_SLOTS];
+
+    // Doubly linked lists of slots per (channel, key)
+    int16_t heads_[CHANNELS * KEYS];
+    int16_t next_[MAX_SLOTS];
+    int16_t prev_[MAX_SLOTS];
+
+    // Note id -> slot, linear probing, -1 marks an empty entry
+    int32_t ids_[ID_TABLE_SIZE];
+    int16_t id_slots_[ID_TABLE_SIZE];
+
+    static bool has_bucket(const NoteKey& key) {
+        return key.channel >= 0 && key.channel < CHANNELS && key.key >= 0 && key.key < KEYS;
+    }
+    static int bucket(const NoteKey& key) { return key.channel * KEYS + key.key; }
+    static int hash(int32_t note_id) {
+        return static_cast<int>((static_cast<uint32_t>(note_id) * 2654435761u) >> (32 - ID_BITS));
+    }
+
+    void link(int slot);
+    void unlink(int slot);
+    void insert_id(int32_t note_id, int slot);
+    int find_id(int32_t note_id, int slot) const;
+    void erase_id(int pos);
+};
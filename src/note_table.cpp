@@ -0,0 +1,34 @@
+#include "note_table.h"
+#include <algorithm>
+#include <cmath>
+
+NoteTable::NoteTable()
+    : sample_rate_(0.0)
+{
+    set_sample_rate(44100.0);
+}
+
+void NoteTable::set_sample_rate(double sample_rate) {
+    if (sample_rate == sample_rate_) {
+        return;
+    }
+    sample_rate_ = sample_rate;
+    for (int note = 0; note < NOTE_COUNT; ++note) {
+        const double increment = note_tables::frequencies[note] / sample_rate_ * 4294967296.0;
+        increment_[note] = static_cast<uint32_t>(std::min(increment, MAX_INCREMENT));
+    }
+}
+
+uint32_t NoteTable::phase_increment(double note) const {
+    note = std::clamp(note, 0.0, static_cast<double>(NOTE_COUNT - 1));
+    const int base = std::min(static_cast<int>(note), NOTE_COUNT - 2);
+    const double position = (note - base) * note_tables::FINE_STEPS;
+
+    // A full semitone above base only happens at the top note
+    const int semitone = static_cast<int>(position) / note_tables::FINE_STEPS;
+    const int index = static_cast<int>(position) % note_tables::FINE_STEPS;
+    const double t = position - std::floor(position);
+    const auto& fine = note_tables::fine_ratios;
+    const double ratio = fine[index] + t * (fine[index + 1] - fine[index]);
+    return static_cast<uint32_t>(std::min(increment_[base + semitone] * ratio, MAX_INCREMENT));
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace note_tables {
+
+constexpr int NOTE_COUNT = 128;
+// Resolution of the fine pitch table, in steps per semitone
+constexpr int FINE_STEPS = 128;
+
+// exp(x * ln 2) by Taylor series, accurate to double precision for |x| <= 1
+constexpr double exp2_series(double x) {
+    const double y = x * 0.69314718055994530942;
+    double term = 1.0;
+    double sum = 1.0;
+    for (int k = 1; k < 30; ++k) {
+        term *= y / k;
+        sum += term;
+    }
+    return sum;
+}
+
+// f = 440 * 2^((n-69)/12), split into whole octaves and a remainder
+constexpr double note_frequency(int note) {
+    int semitones = note - 69;
+    double frequency = 440.0;
+    while (semitones < 0) {
+        semitones += 12;
+        frequency *= 0.5;
+    }
+    while (semitones >= 12) {
+        semitones -= 12;
+        frequency *= 2.0;
+    }
+    return frequency * exp2_series(semitones / 12.0);
+}
+
+constexpr std::array<double, NOTE_COUNT> make_frequencies() {
+    std::array<double, NOTE_COUNT> table = {};
+    for (int note = 0; note < NOTE_COUNT; ++note) {
+        table[note] = note_frequency(note);
+    }
+    return table;
+}
+
+// 2^(i / (12 * FINE_STEPS)), one extra entry for interpolation
+constexpr std::array<double, FINE_STEPS + 1> make_fine_ratios() {
+    std::array<double, FINE_STEPS + 1> table = {};
+    for (int i = 0; i <= FINE_STEPS; ++i) {
+        table[i] = exp2_series(i / (12.0 * FINE_STEPS));
+    }
+    return table;
+}
+
+inline constexpr std::array<double, NOTE_COUNT> frequencies = make_frequencies();
+inline constexpr std::array<double, FINE_STEPS + 1> fine_ratios = make_fine_ratios();
+
+} // namespace note_tables
+
+// MIDI note to phase increment lookup. The note frequencies and the fine
+// pitch ratios are computed at compile time; only the per-note phase
+// increments depend on the sample rate and are rebuilt when it changes.
+class NoteTable {
+public:
+    static constexpr int NOTE_COUNT = note_tables::NOTE_COUNT;
+
+    NoteTable();
+
+    // Recompute the phase increments, does nothing if the rate is unchanged
+    void set_sample_rate(double sample_rate);
+    double sample_rate() const { return sample_rate_; }
+
+    // Phase increment of a MIDI note, in 1/2^32 cycles per sample
+    uint32_t phase_increment(int note) const { return increment_[note & (NOTE_COUNT - 1)]; }
+
+    // Phase increment of a fractional note (bent or detuned), interpolated
+    // from the fine pitch table
+    uint32_t phase_increment(double note) const;
+
+private:
+    // Increments are capped just below Nyquist (2^31)
+    static constexpr double MAX_INCREMENT = 2147483647.0;
+
+    double sample_rate_;
+    uint32_t increment_[NOTE_COUNT];
+};
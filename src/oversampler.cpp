@@ -0,0 +1,164 @@
+#include "oversampler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+
+// Sections and transition bandwidth (relative to the stage's input rate) of
+// each stage, counted back from the last one. The stage before the last
+// only has to reject [3/8, 1/2] of its input rate, the one before that
+// [7/16, 1/2].
+struct StageSpec {
+    int coef_count;
+    double transition;
+};
+
+constexpr StageSpec STAGE_SPECS[3][3] = {
+    {{4, 0.1}, {3, 0.25}, {2, 0.375}},
+    {{8, 0.05}, {4, 0.25}, {3, 0.375}},
+    {{12, 0.02}, {5, 0.25}, {3, 0.375}},
+};
+
+// Allpass coefficients of a half-band elliptic filter with coef_count
+// sections and the given transition band, after HIIR's
+// PolyphaseIir2Designer. The series converge in a handful of terms.
+void design_half_band(int coef_count, double transition, float* coefs) {
+    double k = std::tan((1.0 - transition * 2.0) * PI / 4.0);
+    k *= k;
+    const double kksqrt = std::pow(1.0 - k * k, 0.25);
+    const double e = 0.5 * (1.0 - kksqrt) / (1.0 + kksqrt);
+    const double e4 = e * e * e * e;
+    const double q = e * (1.0 + e4 * (2.0 + e4 * (15.0 + 150.0 * e4)));
+
+    const int order = coef_count * 2 + 1;
+    for (int index = 0; index < coef_count; ++index) {
+        const int c = index + 1;
+
+        double num = 0.0;
+        double term = 0.0;
+        int i = 0;
+        double sign = 1.0;
+        do {
+            term = std::pow(q, i * (i + 1)) * std::sin((i * 2 + 1) * c * PI / order) * sign;
+            num += term;
+            sign = -sign;
+            ++i;
+        } while (std::fabs(term) > 1e-100);
+        num *= std::pow(q, 0.25);
+
+        double den = 0.0;
+        i = 1;
+        sign = -1.0;
+        do {
+            term = std::pow(q, i * i) * std::cos(i * 2 * c * PI / order) * sign;
+            den += term;
+            sign = -sign;
+            ++i;
+        } while (std::fabs(term) > 1e-100);
+        den += 0.5;
+
+        const double ww = num / den;
+        const double wwsq = ww * ww;
+        const double x = std::sqrt((1.0 - wwsq * k) * (1.0 - wwsq / k)) / (1.0 + wwsq);
+        coefs[index] = static_cast<float>((1.0 - x) / (1.0 + x));
+    }
+}
+
+} // namespace
+
+Oversampler::Oversampler()
+    : factor_(1)
+    , stage_count_(0)
+    , quality_(QUALITY_MEDIUM)
+    , stages_(designs_[QUALITY_MEDIUM])
+{
+}
+
+void Oversampler::set_factor(int factor, uint32_t max_frames) {
+    factor_ = 1;
+    stage_count_ = 0;
+    while (factor_ < std::min(factor, MAX_FACTOR)) {
+        factor_ *= 2;
+        ++stage_count_;
+    }
+
+    for (int quality = 0; quality < QUALITY_COUNT; ++quality) {
+        for (int stage = 0; stage < stage_count_; ++stage) {
+            const StageSpec& spec = STAGE_SPECS[quality][stage_count_ - 1 - stage];
+            HalfBand& band = designs_[quality][stage];
+            band.coef_count = spec.coef_count;
+            design_half_band(spec.coef_count, spec.transition, band.coefs);
+        }
+    }
+
+    buffer_.assign(static_cast<size_t>(max_frames) * factor_, 0.0f);
+    reset();
+}
+
+void Oversampler::set_quality(int quality) {
+    quality_ = std::clamp(quality, 0, QUALITY_COUNT - 1);
+    stages_ = designs_[quality_];
+    reset();
+}
+
+void Oversampler::reset() {
+    for (int stage = 0; stage < stage_count_; ++stage) {
+        stages_[stage].reset();
+    }
+}
+
+void Oversampler::decimate(float* out, uint32_t n) {
+    // Each stage halves the buffer in place, the last one writes out
+    uint32_t frames = n * static_cast<uint32_t>(factor_);
+    for (int stage = 0; stage < stage_count_; ++stage) {
+        frames /= 2;
+        float* target = stage == stage_count_ - 1 ? out : buffer_.data();
+        stages_[stage].process(buffer_.data(), target, frames);
+    }
+}
+
+void Oversampler::HalfBand::process(const float* in, float* out, uint32_t n) {
+    for (uint32_t i = 0; i < n; ++i) {
+        float odd = in[2 * i + 1];
+        float even = in[2 * i];
+
+        // The two chains are independent, so their sections interleave
+        int c = 0;
+        for (; c + 1 < coef_count; c += 2) {
+            const float odd_out = coefs[c] * (odd - y[c]) + x[c];
+            x[c] = odd;
+            y[c] = odd_out;
+            odd = odd_out;
+
+            const float even_out = coefs[c + 1] * (even - y[c + 1]) + x[c + 1];
+            x[c + 1] = even;
+            y[c + 1] = even_out;
+            even = even_out;
+        }
+        if (c < coef_count) {
+            const float odd_out = coefs[c] * (odd - y[c]) + x[c];
+            x[c] = odd;
+            y[c] = odd_out;
+            odd = odd_out;
+        }
+
+        out[i] = 0.5f * (odd + even);
+    }
+
+    // Let decaying tails end in zeros rather than denormals
+    for (int section = 0; section < coef_count; ++section) {
+        if (std::fabs(y[section]) < 1e-20f) {
+            y[section] = 0.0f;
+        }
+        if (std::fabs(x[section]) < 1e-20f) {
+            x[section] = 0.0f;
+        }
+    }
+}
+
+void Oversampler::HalfBand::reset() {
+    std::fill(x, x + MAX_COEFS, 0.0f);
+    std::fill(y, y + MAX_COEFS, 0.0f);
+}
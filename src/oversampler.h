@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Brings the voice sum, rendered at 2x, 4x or 8x the host rate, back down to
+// the host rate. Only the voices (oscillators and filters) run oversampled;
+// volume and the stereo mix stay at the host rate. The decimation is linear,
+// so one filter on the sum does the job of one per voice.
+//
+// Each halving is a polyphase IIR half-band filter: two chains of first
+// order allpass sections running at the lower rate, one fed the even and one
+// the odd input samples (L. de Soras, HIIR). The stages before the last one
+// only have to keep images out of the band the last stage passes, so they
+// get by with a much wider transition band and fewer sections.
+class Oversampler {
+public:
+    static constexpr int MAX_FACTOR = 8;
+
+    enum Quality {
+        QUALITY_LOW = 0,    // About 70 dB image rejection
+        QUALITY_MEDIUM,     // About 105 dB
+        QUALITY_HIGH,       // About 120 dB, flat to 0.49 of the host rate
+        QUALITY_COUNT
+    };
+
+    Oversampler();
+
+    // Size the buffer for max_frames host frames at factor (1, 2, 4 or 8)
+    // and design the filters. Allocates, call from activate().
+    void set_factor(int factor, uint32_t max_frames);
+    int factor() const { return factor_; }
+
+    // Switch filter sets; clears the filter state
+    void set_quality(int quality);
+    void reset();
+
+    // Where the voices render factor() * n samples for n host frames
+    float* buffer() { return buffer_.data(); }
+
+    // Decimate factor() * n samples of buffer() into n frames of out
+    void decimate(float* out, uint32_t n);
+
+private:
+    static constexpr int MAX_STAGES = 3;
+    static constexpr int MAX_COEFS = 12;
+
+    struct HalfBand {
+        int coef_count = 0;
+        float coefs[MAX_COEFS] = {};
+        // Input and output of every allpass section; even sections belong
+        // to the odd-sample chain, odd sections to the even-sample chain
+        float x[MAX_COEFS] = {};
+        float y[MAX_COEFS] = {};
+
+        // Halve 2n samples of in into n samples of out, which may alias in
+        void process(const float* in, float* out, uint32_t n);
+        void reset();
+    };
+
+    int factor_;
+    int stage_count_;
+    int quality_;
+    // Every quality is designed up front so set_quality() never computes
+    HalfBand designs_[QUALITY_COUNT][MAX_STAGES];
+    HalfBand* stages_;
+    std::vector<float> buffer_;
+};
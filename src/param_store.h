@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <clap/clap.h>
+#include "spsc_queue.h"
+
+// A parameter change or gesture crossing between threads
+struct ParamEvent {
+    enum Type : uint32_t {
+        VALUE,
+        GESTURE_BEGIN,
+        GESTURE_END
+    };
+
+    Type type;
+    clap_id param_id;
+    double value;
+};
+
+// Thread-safe view of Count parameters. The audio thread owns the values the
+// DSP runs on and publishes every value it applies here, so the host and
+// the editor can read them from any thread without locks or torn doubles.
+// Edits travel the other way through a queue the audio thread drains at the
+// start of each process() or flush(). Applied values only mark their
+// parameter dirty, so an editor can follow automation without polling every
+// parameter, however many values were applied since it last looked.
+template <int Count>
+class ParamStore {
+public:
+    static constexpr uint32_t QUEUE_SIZE = 256;
+    static_assert(std::atomic<double>::is_always_lock_free, "parameter values must be lock-free");
+
+    ParamStore() {
+        for (std::atomic<double>& value : values_) {
+            value.store(0.0, std::memory_order_relaxed);
+        }
+        for (int word = 0; word < DIRTY_WORDS; ++word) {
+            dirty_[word].store(0, std::memory_order_relaxed);
+            draining_[word] = 0;
+        }
+    }
+
+    // Any thread
+    double value(clap_id param_id) const { return values_[param_id].load(std::memory_order_relaxed); }
+
+    // Audio thread (or the main thread while inactive): make an applied
+    // value visible
+    void publish(clap_id param_id, double value) {
+        values_[param_id].store(value, std::memory_order_relaxed);
+        dirty_[param_id / 64].fetch_or(uint64_t(1) << (param_id % 64), std::memory_order_release);
+    }
+
+    // Main thread: hand an edit to the audio thread; false if the queue is full
+    bool send_to_audio(const ParamEvent& event) { return to_audio_.push(event); }
+    // Main thread: next parameter published since the last call, with its
+    // latest value. Parameters come round in id order, each once per sweep.
+    bool receive_on_main(clap_id* param_id, double* value) {
+        for (int pass = 0; pass < 2; ++pass) {
+            for (int word = 0; word < DIRTY_WORDS; ++word) {
+                if (draining_[word] != 0) {
+                    const int bit = lowest_bit(draining_[word]);
+                    draining_[word] &= draining_[word] - 1;
+                    *param_id = static_cast<clap_id>(word * 64 + bit);
+                    *value = values_[*param_id].load(std::memory_order_relaxed);
+                    return true;
+                }
+            }
+            // Sweep done, take whatever was published meanwhile
+            for (int word = 0; word < DIRTY_WORDS; ++word) {
+                draining_[word] = dirty_[word].exchange(0, std::memory_order_acquire);
+            }
+        }
+        return false;
+    }
+
+    // Audio thread: next edit from the main thread
+    bool receive_on_audio(ParamEvent* event) { return to_audio_.pop(event); }
+
+private:
+    static constexpr int DIRTY_WORDS = (Count + 63) / 64;
+
+    std::atomic<double> values_[Count];
+    SpscQueue<ParamEvent, QUEUE_SIZE> to_audio_;
+    std::atomic<uint64_t> dirty_[DIRTY_WORDS];
+    uint64_t draining_[DIRTY_WORDS];   // Main thread's copy of dirty_ being handed out
+
+    static int lowest_bit(uint64_t bits) {
+        int bit = 0;
+        while ((bits & 1) == 0) {
+            bits >>= 1;
+            ++bit;
+        }
+        return bit;
+    }
+};
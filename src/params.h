@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <clap/clap.h>
+#include "oversampler.h"
+#include "voice.h"
+#include "voice_bank.h"
+#include "voice_stealing.h"
+
+// Every parameter of the synth is described once, here. The table drives
+// the CLAP params extension (info, text conversion), range checks and the
+// dispatch of changes, so a new parameter is one entry plus its use in the
+// DSP.
+
+enum ParamId : clap_id {
+    PARAM_ATTACK = 0,
+    PARAM_DECAY,
+    PARAM_SUSTAIN,
+    PARAM_RELEASE,
+    PARAM_VOLUME,
+    PARAM_WAVEFORM,
+    PARAM_POLYPHONY,
+    PARAM_VOICE_STEALING,
+    PARAM_FILTER_CUTOFF,
+    PARAM_FILTER_RESONANCE,
+    PARAM_FILTER_ENV_AMOUNT,
+    PARAM_FILTER_KEY_TRACK,
+    PARAM_OVERSAMPLING,
+    PARAM_OVERSAMPLING_QUALITY,
+    PARAM_PIN_WORKER_THREADS,
+    PARAM_COUNT
+};
+
+// What has to follow a change, beyond storing the value. Parameters that
+// are only read when a note starts need nothing.
+enum ParamUpdate {
+    UPDATE_NONE = 0,
+    UPDATE_VOLUME,
+    UPDATE_FILTERS,
+    UPDATE_VOICE_STEALING,
+    UPDATE_POLYPHONY,
+    UPDATE_OVERSAMPLING,
+    UPDATE_OVERSAMPLING_QUALITY,
+    UPDATE_WORKER_PINNING
+};
+
+struct ParamDescriptor;
+
+using ParamFormatter = void (*)(const ParamDescriptor& param, double value, char* display, uint32_t size);
+using ParamParser = bool (*)(const ParamDescriptor& param, const char* display, double* value);
+
+struct ParamDescriptor {
+    ParamId id;
+    const char* name;
+    const char* module;
+    double min_value;
+    double max_value;
+    double default_value;
+    clap_param_info_flags flags;
+    ParamFormatter format;
+    ParamParser parse;
+    // Names of the steps of a choice parameter, null otherwise
+    const char* const* choices;
+    ParamUpdate update;
+
+    // Clamped to the range, and to a whole step for stepped parameters
+    double constrain(double value) const {
+        value = std::clamp(value, min_value, max_value);
+        return (flags & CLAP_PARAM_IS_STEPPED) ? static_cast<double>(static_cast<int>(value + 0.5)) : value;
+    }
+};
+
+namespace param_formats {
+
+// Leading number of a display string, units after it are ignored
+inline bool number(const char* display, double* value) {
+    char* end = nullptr;
+    const double parsed = std::strtod(display, &end);
+    if (end == display) {
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+inline void seconds(const ParamDescriptor&, double value, char* display, uint32_t size) {
+    std::snprintf(display, size, "%.3f s", value);
+}
+
+inline void percent(const ParamDescriptor&, double value, char* display, uint32_t size) {
+    std::snprintf(display, size, "%.1f%%", value * 100.0);
+}
+
+inline bool parse_percent(const ParamDescriptor&, const char* display, double* value) {
+    if (!number(display, value)) {
+        return false;
+    }
+    *value /= 100.0;
+    return true;
+}
+
+inline void hertz(const ParamDescriptor&, double value, char* display, uint32_t size) {
+    std::snprintf(display, size, "%.0f Hz", value);
+}
+
+inline void octaves(const ParamDescriptor&, double value, char* display, uint32_t size) {
+    std::snprintf(display, size, "%+.1f oct", value);
+}
+
+inline void voices(const ParamDescriptor&, double value, char* display, uint32_t size) {
+    std::snprintf(display, size, "%d voices", static_cast<int>(value + 0.5));
+}
+
+// Plain numbers in the parameter's own unit
+inline bool parse_plain(const ParamDescriptor&, const char* display, double* value) {
+    return number(display, value);
+}
+
+// Powers of two, the value is the exponent
+inline void factor(const ParamDescriptor& param, double value, char* display, uint32_t size) {
+    std::snprintf(display, size, "%dx", 1 << static_cast<int>(param.constrain(value)));
+}
+
+inline bool parse_factor(const ParamDescriptor&, const char* display, double* value) {
+    double factor;
+    if (!number(display, &factor) || factor < 1.0) {
+        return false;
+    }
+    *value = std::round(std::log2(factor));
+    return true;
+}
+
+inline void choice(const ParamDescriptor& param, double value, char* display, uint32_t size) {
+    std::snprintf(display, size, "%s", param.choices[static_cast<int>(param.constrain(value) - param.min_value)]);
+}
+
+// A choice name, or its index
+inline bool parse_choice(const ParamDescriptor& param, const char* display, double* value) {
+    const int count = static_cast<int>(param.max_value - param.min_value) + 1;
+    for (int i = 0; i < count; ++i) {
+        if (std::strcmp(display, param.choices[i]) == 0) {
+            *value = param.min_value + i;
+            return true;
+        }
+    }
+    return number(display, value);
+}
+
+} // namespace param_formats
+
+namespace param_choices {
+
+inline constexpr const char* WAVEFORMS[] = {"Sine", "Square", "Saw", "Triangle", "Pulse"};
+inline constexpr const char* STEAL_POLICIES[] = {"Oldest", "Quietest", "Released First", "Same Note"};
+inline constexpr const char* QUALITIES[] = {"Low", "Medium", "High"};
+inline constexpr const char* SWITCH[] = {"Off", "On"};
+
+static_assert(sizeof(WAVEFORMS) / sizeof(WAVEFORMS[0]) == WAVE_COUNT, "one name per waveform");
+static_assert(sizeof(STEAL_POLICIES) / sizeof(STEAL_POLICIES[0]) == STEAL_POLICY_COUNT, "one name per policy");
+static_assert(sizeof(QUALITIES) / sizeof(QUALITIES[0]) == Oversampler::QUALITY_COUNT, "one name per quality");
+
+} // namespace param_choices
+
+constexpr clap_param_info_flags AUTOMATABLE = CLAP_PARAM_IS_AUTOMATABLE;
+constexpr clap_param_info_flags AUTOMATABLE_STEPPED = CLAP_PARAM_IS_AUTOMATABLE | CLAP_PARAM_IS_STEPPED;
+constexpr clap_param_info_flags STEPPED = CLAP_PARAM_IS_STEPPED;
+// Named steps; hosts show a menu instead of a slider
+constexpr clap_param_info_flags AUTOMATABLE_CHOICE = AUTOMATABLE_STEPPED | CLAP_PARAM_IS_ENUM;
+constexpr clap_param_info_flags CHOICE = STEPPED | CLAP_PARAM_IS_ENUM;
+
+// Polyphony and Oversampling resize the voice engine and worker pinning
+// only happens when the threads start, so they need a restart and are not
+// automatable
+inline constexpr ParamDescriptor PARAMS[PARAM_COUNT] = {
+    {PARAM_ATTACK, "Attack", "Envelope", 0.001, 5.0, 0.01, AUTOMATABLE,
+     param_formats::seconds, param_formats::parse_plain, nullptr, UPDATE_NONE},
+    {PARAM_DECAY, "Decay", "Envelope", 0.001, 5.0, 0.1, AUTOMATABLE,
+     param_formats::seconds, param_formats::parse_plain, nullptr, UPDATE_NONE},
+    {PARAM_SUSTAIN, "Sustain", "Envelope", 0.0, 1.0, 0.7, AUTOMATABLE,
+     param_formats::percent, param_formats::parse_percent, nullptr, UPDATE_NONE},
+    {PARAM_RELEASE, "Release", "Envelope", 0.001, 5.0, 0.3, AUTOMATABLE,
+     param_formats::seconds, param_formats::parse_plain, nullptr, UPDATE_NONE},
+    {PARAM_VOLUME, "Volume", "Main", 0.0, 1.0, 0.8, AUTOMATABLE,
+     param_formats::percent, param_formats::parse_percent, nullptr, UPDATE_VOLUME},
+    {PARAM_WAVEFORM, "Waveform", "Oscillator", 0.0, WAVE_COUNT - 1, WAVE_SINE, AUTOMATABLE_CHOICE,
+     param_formats::choice, param_formats::parse_choice, param_choices::WAVEFORMS, UPDATE_NONE},
+    {PARAM_POLYPHONY, "Polyphony", "Main",
+     VoiceBank::MIN_VOICES, VoiceBank::MAX_VOICES, VoiceBank::DEFAULT_VOICES, STEPPED,
+     param_formats::voices, param_formats::parse_plain, nullptr, UPDATE_POLYPHONY},
+    {PARAM_VOICE_STEALING, "Voice Stealing", "Main", 0.0, STEAL_POLICY_COUNT - 1, STEAL_RELEASED_FIRST, CHOICE,
+     param_formats::choice, param_formats::parse_choice, param_choices::STEAL_POLICIES, UPDATE_VOICE_STEALING},
+    {PARAM_FILTER_CUTOFF, "Cutoff", "Filter", Voice::MIN_CUTOFF, Voice::MAX_CUTOFF, Voice::MAX_CUTOFF, AUTOMATABLE,
+     param_formats::hertz, param_formats::parse_plain, nullptr, UPDATE_FILTERS},
+    {PARAM_FILTER_RESONANCE, "Resonance", "Filter", 0.0, 1.0, 0.0, AUTOMATABLE,
+     param_formats::percent, param_formats::parse_percent, nullptr, UPDATE_FILTERS},
+    {PARAM_FILTER_ENV_AMOUNT, "Envelope Amount", "Filter", -8.0, 8.0, 0.0, AUTOMATABLE,
+     param_formats::octaves, param_formats::parse_plain, nullptr, UPDATE_FILTERS},
+    {PARAM_FILTER_KEY_TRACK, "Keyboard Tracking", "Filter", 0.0, 1.0, 0.0, AUTOMATABLE,
+     param_formats::percent, param_formats::parse_percent, nullptr, UPDATE_FILTERS},
+    {PARAM_OVERSAMPLING, "Oversampling", "Main", 0.0, 3.0, 0.0, CHOICE,
+     param_formats::factor, param_formats::parse_factor, nullptr, UPDATE_OVERSAMPLING},
+    {PARAM_OVERSAMPLING_QUALITY, "Oversampling Quality", "Main",
+     0.0, Oversampler::QUALITY_COUNT - 1, Oversampler::QUALITY_MEDIUM, CHOICE,
+     param_formats::choice, param_formats::parse_choice, param_choices::QUALITIES, UPDATE_OVERSAMPLING_QUALITY},
+    {PARAM_PIN_WORKER_THREADS, "Pin Worker Threads", "Main", 0.0, 1.0, 0.0, CHOICE,
+     param_formats::choice, param_formats::parse_choice, param_choices::SWITCH, UPDATE_WORKER_PINNING},
+};
+
+// The table is indexed by id
+constexpr bool params_in_id_order() {
+    for (clap_id i = 0; i < PARAM_COUNT; ++i) {
+        if (PARAMS[i].id != static_cast<ParamId>(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(params_in_id_order(), "PARAMS must list every parameter in ParamId order");
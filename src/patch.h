@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "params.h"
+#include "spsc_queue.h"
+
+// A complete set of parameter values: a preset, a program or a loaded state.
+// Built on the main thread and applied by the audio thread in one piece, so
+// no block ever runs on half of one patch and half of another.
+class Patch {
+public:
+    Patch() {
+        for (clap_id param_id = 0; param_id < PARAM_COUNT; ++param_id) {
+            values_[param_id] = PARAMS[param_id].default_value;
+        }
+    }
+
+    double value(ParamId param_id) const { return values_[param_id]; }
+    // Constrained to the parameter's range
+    void set_value(ParamId param_id, double value) { values_[param_id] = PARAMS[param_id].constrain(value); }
+
+private:
+    double values_[PARAM_COUNT];
+};
+
+// Hands patches from the main thread to the audio thread with one atomic
+// pointer swap, and back again to be freed. The audio thread never
+// allocates or frees a patch; it retires the ones it applied and the main
+// thread deletes them in collect().
+//
+// A patch stays pending while the audio thread applies it, and only leaves
+// once its values are visible elsewhere, so the main thread always finds
+// the newest values in one place or the other. The audio thread marks the
+// patch it is reading, and the main thread holds back a replaced patch
+// still marked until the next collect().
+class PatchExchange {
+public:
+    PatchExchange() : pending_(nullptr), reading_(nullptr), replaced_(nullptr) {}
+    PatchExchange(const PatchExchange&) = delete;
+    PatchExchange& operator=(const PatchExchange&) = delete;
+
+    ~PatchExchange() {
+        discard();
+        collect();
+        delete replaced_;
+    }
+
+    // Main thread: make patch the next one the audio thread applies. A
+    // patch it has not taken yet is replaced and freed here.
+    void publish(Patch* patch) {
+        collect();
+        replace(pending_.exchange(patch));
+    }
+
+    // Main thread: the published patch whose values have not reached the
+    // audio thread's parameters yet. Only the main thread frees patches, so
+    // it stays valid until the next publish(), discard() or collect().
+    const Patch* pending() const { return pending_.load(); }
+
+    // Main thread: withdraw the pending patch
+    void discard() { replace(pending_.exchange(nullptr)); }
+
+    // Main thread: free the patches the audio thread is done with
+    void collect() {
+        Patch* patch;
+        while (retired_.pop(&patch)) {
+            delete patch;
+        }
+        if (replaced_ && replaced_ != reading_.load()) {
+            delete replaced_;
+            replaced_ = nullptr;
+        }
+    }
+
+    // Audio thread: the pending patch, if any, to apply. It stays pending
+    // until finish().
+    const Patch* begin() {
+        Patch* patch = pending_.load();
+        while (patch) {
+            // Once marked and still pending, the main thread keeps it alive
+            reading_.store(patch);
+            Patch* const current = pending_.load();
+            if (current == patch) {
+                return patch;
+            }
+            patch = current;
+        }
+        reading_.store(nullptr);
+        return nullptr;
+    }
+
+    // Audio thread: patch from begin() is applied and its values published.
+    // Unless a newer patch replaced it meanwhile, it leaves pending and is
+    // handed back for collect(). Every publish() collects first, so no more
+    // than two patches are ever waiting there.
+    void finish(const Patch* patch) {
+        Patch* expected = const_cast<Patch*>(patch);
+        const bool ours = pending_.compare_exchange_strong(expected, nullptr);
+        reading_.store(nullptr);
+        if (ours) {
+            retired_.push(const_cast<Patch*>(patch));
+        }
+    }
+
+private:
+    static constexpr uint32_t RETIRED_SIZE = 8;
+
+    std::atomic<Patch*> pending_;
+    // Patch the audio thread is between begin() and finish() on
+    std::atomic<Patch*> reading_;
+    // Main thread: a replaced patch that was still being read
+    Patch* replaced_;
+    SpscQueue<Patch*, RETIRED_SIZE> retired_;
+
+    // Main thread: free a patch that is no longer pending, or hold it back
+    // while the audio thread reads it. The audio thread only ever marks
+    // pending patches, so an older held-back one is free to go.
+    void replace(Patch* patch) {
+        if (!patch) {
+            return;
+        }
+        if (patch != reading_.load()) {
+            delete patch;
+            return;
+        }
+        delete replaced_;
+        replaced_ = patch;
+    }
+};
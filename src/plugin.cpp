@@ -1,5 +1,6 @@
 #include <clap/clap.h>
 #include "simple_synth.h"
+#include "dsp_dispatch.h"
 #include <cstring>
 
 // Plugin descriptor
@@ -108,6 +109,20 @@ static const void* plugin_get_extension(const clap_plugin_t* plugin, const char*
         return &params_ext;
     }
     
+    if (std::strcmp(id, CLAP_EXT_STATE) == 0) {
+        static const clap_plugin_state_t state_ext = {
+            .save = [](const clap_plugin_t* plugin, const clap_ostream_t* stream) -> bool {
+                PluginData* data = static_cast<PluginData*>(plugin->plugin_data);
+                return data->synth->state_save(stream);
+            },
+            .load = [](const clap_plugin_t* plugin, const clap_istream_t* stream) -> bool {
+                PluginData* data = static_cast<PluginData*>(plugin->plugin_data);
+                return data->synth->state_load(stream);
+            }
+        };
+        return &state_ext;
+    }
+    
     if (std::strcmp(id, CLAP_EXT_NOTE_PORTS) == 0) {
         static const clap_plugin_note_ports_t note_ports_ext = {
             .count = [](const clap_plugin_t* plugin, bool is_input) -> uint32_t {
@@ -138,6 +153,16 @@ static const void* plugin_get_extension(const clap_plugin_t* plugin, const char*
         return &audio_ports_ext;
     }
     
+    if (std::strcmp(id, CLAP_EXT_THREAD_POOL) == 0) {
+        static const clap_plugin_thread_pool_t thread_pool_ext = {
+            .exec = [](const clap_plugin_t* plugin, uint32_t task_index) {
+                PluginData* data = static_cast<PluginData*>(plugin->plugin_data);
+                data->synth->thread_pool_exec(task_index);
+            }
+        };
+        return &thread_pool_ext;
+    }
+    
     // GUI extension disabled for now
     /*
     if (std::strcmp(id, CLAP_EXT_GUI) == 0) {
@@ -150,7 +175,8 @@ static const void* plugin_get_extension(const clap_plugin_t* plugin, const char*
 }
 
 static void plugin_on_main_thread(const clap_plugin_t* plugin) {
-    // Not used in this simple implementation
+    PluginData* data = static_cast<PluginData*>(plugin->plugin_data);
+    data->synth->on_main_thread();
 }
 
 // Plugin factory
@@ -208,6 +234,8 @@ extern "C" {
     CLAP_EXPORT const clap_plugin_entry_t clap_entry = {
         .clap_version = CLAP_VERSION_INIT,
         .init = [](const char* plugin_path) -> bool {
+            // Pick the DSP kernels for this CPU once per process
+            select_dsp_kernels();
             return true;
         },
         .deinit = []() {
@@ -0,0 +1,120 @@
+#include "plugin_state.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr uint8_t MAGIC[4] = {'S', 'S', 'Y', 'N'};
+constexpr uint32_t HEADER_SIZE = 12;
+constexpr uint32_t RECORD_SIZE = 12;
+
+void put_u32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+void put_f64(uint8_t* out, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; ++i) {
+        out[i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+}
+
+uint32_t get_u32(const uint8_t* in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+double get_f64(const uint8_t* in) {
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; ++i) {
+        bits |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Streams may move fewer bytes than asked per call
+bool write_all(const clap_ostream_t* stream, const uint8_t* data, uint32_t size) {
+    while (size > 0) {
+        const int64_t written = stream->write(stream, data, size);
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= static_cast<uint32_t>(written);
+    }
+    return true;
+}
+
+bool read_all(const clap_istream_t* stream, uint8_t* data, uint32_t size) {
+    while (size > 0) {
+        const int64_t read = stream->read(stream, data, size);
+        if (read <= 0) {
+            return false;
+        }
+        data += read;
+        size -= static_cast<uint32_t>(read);
+    }
+    return true;
+}
+
+} // namespace
+
+namespace plugin_state {
+
+bool save(const clap_ostream_t* stream, const Patch& patch) {
+    uint8_t data[HEADER_SIZE + RECORD_SIZE * PARAM_COUNT];
+    std::memcpy(data, MAGIC, sizeof(MAGIC));
+    put_u32(data + 4, STATE_VERSION);
+    put_u32(data + 8, PARAM_COUNT);
+
+    uint8_t* record = data + HEADER_SIZE;
+    for (clap_id param_id = 0; param_id < PARAM_COUNT; ++param_id) {
+        put_u32(record, param_id);
+        put_f64(record + 4, patch.value(static_cast<ParamId>(param_id)));
+        record += RECORD_SIZE;
+    }
+    return write_all(stream, data, sizeof(data));
+}
+
+bool load(const clap_istream_t* stream, Patch* patch) {
+    uint8_t header[HEADER_SIZE];
+    if (!read_all(stream, header, HEADER_SIZE) || std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0) {
+        return false;
+    }
+    const uint32_t version = get_u32(header + 4);
+    const uint32_t count = get_u32(header + 8);
+    // A newer version gave some id a meaning we cannot convert back from
+    if (version == 0 || version > STATE_VERSION || count > MAX_RECORDS) {
+        return false;
+    }
+
+    std::vector<uint8_t> records(static_cast<size_t>(count) * RECORD_SIZE);
+    if (!read_all(stream, records.data(), static_cast<uint32_t>(records.size()))) {
+        return false;
+    }
+
+    // Parameters the state does not mention start from their defaults
+    Patch loaded;
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint8_t* record = records.data() + static_cast<size_t>(i) * RECORD_SIZE;
+        const uint32_t param_id = get_u32(record);
+        const double value = get_f64(record + 4);
+        if (param_id < PARAM_COUNT && std::isfinite(value)) {
+            loaded.set_value(static_cast<ParamId>(param_id), value);
+        }
+    }
+
+    *patch = loaded;
+    return true;
+}
+
+} // namespace plugin_state
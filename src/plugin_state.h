@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <clap/clap.h>
+#include "patch.h"
+
+// The clap.state blob: every parameter as an (id, value) record behind a
+// small header, all little-endian whatever the machine.
+//
+//   "SSYN"              magic
+//   uint32 version      STATE_VERSION when written
+//   uint32 count        number of records
+//   count x {uint32 id, float64 value}
+//
+// Records are looked up by id, so states from newer builds with more
+// parameters load (unknown ids are skipped) and older ones leave the
+// parameters they lack at their defaults. The version only moves when the
+// meaning of an existing id changes; load() then converts older values and
+// refuses newer ones.
+namespace plugin_state {
+
+constexpr uint32_t STATE_VERSION = 1;
+// Far above any parameter count we will reach; bounds what load() reads
+constexpr uint32_t MAX_RECORDS = 4096;
+
+// Write patch; false if the stream failed
+bool save(const clap_ostream_t* stream, const Patch& patch);
+
+// Read a state into patch. False, with patch untouched, if the stream failed
+// or does not hold a valid state. Main thread: reads the whole stream.
+bool load(const clap_istream_t* stream, Patch* patch);
+
+} // namespace plugin_state
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// Thin wrappers around the vector instruction sets the voice kernels are
+// written against. Every wrapper exposes the same static interface so a
+// kernel can be instantiated once per instruction set.
+//
+// Each kernel translation unit is compiled with its own target flags and
+// defines SIMD_NAMESPACE first, so the inline wrapper functions it emits
+// never collide with (and get picked by the linker over) the baseline ones.
+
+#ifndef SIMD_NAMESPACE
+#define SIMD_NAMESPACE simd_generic
+#endif
+
+namespace SIMD_NAMESPACE {
+
+struct SimdScalar {
+    using V = float;
+    using VI = uint32_t;
+    using M = bool;
+    static constexpr int width = 1;
+
+    static V zero() { return 0.0f; }
+    static V set1(float x) { return x; }
+    static V load(const float* p) { return *p; }
+    static V loadu(const float* p) { return *p; }
+    static void store(float* p, V a) { *p = a; }
+    static void storeu(float* p, V a) { *p = a; }
+    static V add(V a, V b) { return a + b; }
+    static V sub(V a, V b) { return a - b; }
+    static V mul(V a, V b) { return a * b; }
+    static V div(V a, V b) { return a / b; }
+    static V min(V a, V b) { return a < b ? a : b; }
+    static V max(V a, V b) { return a > b ? a : b; }
+    static M cmp_ge(V a, V b) { return a >= b; }
+    static M cmp_lt(V a, V b) { return a < b; }
+    static V select(M m, V a, V b) { return m ? a : b; }
+    static float hsum(V a) { return a; }
+
+    static VI set1i(uint32_t x) { return x; }
+    static VI loadi(const uint32_t* p) { return *p; }
+    static void storei(uint32_t* p, VI a) { *p = a; }
+    static VI addi(VI a, VI b) { return a + b; }
+    // Signed conversion, only valid below 2^31
+    static V to_float(VI a) { return static_cast<float>(static_cast<int32_t>(a)); }
+    // Top 24 bits of a 32-bit phase as a float in [0, 1), exact
+    static V phase_to_unit(VI a) { return static_cast<float>(a >> 8) * (1.0f / 16777216.0f); }
+};
+
+#if defined(__SSE2__) || defined(_M_X64)
+struct SimdSSE2 {
+    using V = __m128;
+    using VI = __m128i;
+    using M = __m128;
+    static constexpr int width = 4;
+
+    static V zero() { return _mm_setzero_ps(); }
+    static V set1(float x) { return _mm_set1_ps(x); }
+    static V load(const float* p) { return _mm_load_ps(p); }
+    static V loadu(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, V a) { _mm_store_ps(p, a); }
+    static void storeu(float* p, V a) { _mm_storeu_ps(p, a); }
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm_div_ps(a, b); }
+    static V min(V a, V b) { return _mm_min_ps(a, b); }
+    static V max(V a, V b) { return _mm_max_ps(a, b); }
+    static M cmp_ge(V a, V b) { return _mm_cmpge_ps(a, b); }
+    static M cmp_lt(V a, V b) { return _mm_cmplt_ps(a, b); }
+    static V select(M m, V a, V b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+    static float hsum(V a) {
+        __m128 shuf = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1));
+        __m128 sums = _mm_add_ps(a, shuf);
+        shuf = _mm_movehl_ps(shuf, sums);
+        return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+    }
+
+    static VI set1i(uint32_t x) { return _mm_set1_epi32(static_cast<int>(x)); }
+    static VI loadi(const uint32_t* p) { return _mm_load_si128(reinterpret_cast<const __m128i*>(p)); }
+    static void storei(uint32_t* p, VI a) { _mm_store_si128(reinterpret_cast<__m128i*>(p), a); }
+    static VI addi(VI a, VI b) { return _mm_add_epi32(a, b); }
+    static V to_float(VI a) { return _mm_cvtepi32_ps(a); }
+    static V phase_to_unit(VI a) {
+        return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(a, 8)), _mm_set1_ps(1.0f / 16777216.0f));
+    }
+};
+#endif
+
+#if defined(__AVX2__)
+struct SimdAVX2 {
+    using V = __m256;
+    using VI = __m256i;
+    using M = __m256;
+    static constexpr int width = 8;
+
+    static V zero() { return _mm256_setzero_ps(); }
+    static V set1(float x) { return _mm256_set1_ps(x); }
+    static V load(const float* p) { return _mm256_load_ps(p); }
+    static V loadu(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, V a) { _mm256_store_ps(p, a); }
+    static void storeu(float* p, V a) { _mm256_storeu_ps(p, a); }
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm256_div_ps(a, b); }
+    static V min(V a, V b) { return _mm256_min_ps(a, b); }
+    static V max(V a, V b) { return _mm256_max_ps(a, b); }
+    static M cmp_ge(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static M cmp_lt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static V select(M m, V a, V b) { return _mm256_blendv_ps(b, a, m); }
+    static float hsum(V a) {
+        return SimdSSE2::hsum(_mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1)));
+    }
+
+    static VI set1i(uint32_t x) { return _mm256_set1_epi32(static_cast<int>(x)); }
+    static VI loadi(const uint32_t* p) { return _mm256_load_si256(reinterpret_cast<const __m256i*>(p)); }
+    static void storei(uint32_t* p, VI a) { _mm256_store_si256(reinterpret_cast<__m256i*>(p), a); }
+    static VI addi(VI a, VI b) { return _mm256_add_epi32(a, b); }
+    static V to_float(VI a) { return _mm256_cvtepi32_ps(a); }
+    static V phase_to_unit(VI a) {
+        return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(a, 8)), _mm256_set1_ps(1.0f / 16777216.0f));
+    }
+};
+#endif
+
+#if defined(__AVX512F__)
+struct SimdAVX512 {
+    using V = __m512;
+    using VI = __m512i;
+    using M = __mmask16;
+    static constexpr int width = 16;
+
+    static V zero() { return _mm512_setzero_ps(); }
+    static V set1(float x) { return _mm512_set1_ps(x); }
+    static V load(const float* p) { return _mm512_load_ps(p); }
+    static V loadu(const float* p) { return _mm512_loadu_ps(p); }
+    static void store(float* p, V a) { _mm512_store_ps(p, a); }
+    static void storeu(float* p, V a) { _mm512_storeu_ps(p, a); }
+    static V add(V a, V b) { return _mm512_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm512_div_ps(a, b); }
+    static V min(V a, V b) { return _mm512_min_ps(a, b); }
+    static V max(V a, V b) { return _mm512_max_ps(a, b); }
+    static M cmp_ge(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+    static M cmp_lt(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static V select(M m, V a, V b) { return _mm512_mask_blend_ps(m, b, a); }
+    static float hsum(V a) { return _mm512_reduce_add_ps(a); }
+
+    static VI set1i(uint32_t x) { return _mm512_set1_epi32(static_cast<int>(x)); }
+    static VI loadi(const uint32_t* p) { return _mm512_load_si512(p); }
+    static void storei(uint32_t* p, VI a) { _mm512_store_si512(p, a); }
+    static VI addi(VI a, VI b) { return _mm512_add_epi32(a, b); }
+    static V to_float(VI a) { return _mm512_cvtepi32_ps(a); }
+    static V phase_to_unit(VI a) {
+        return _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srli_epi32(a, 8)), _mm512_set1_ps(1.0f / 16777216.0f));
+    }
+};
+#endif
+
+// Widest instruction set enabled for this translation unit
+#if defined(__AVX512F__)
+using SimdNative = SimdAVX512;
+#elif defined(__AVX2__)
+using SimdNative = SimdAVX2;
+#elif defined(__SSE2__) || defined(_M_X64)
+using SimdNative = SimdSSE2;
+#else
+using SimdNative = SimdScalar;
+#endif
+
+} // namespace SIMD_NAMESPACE
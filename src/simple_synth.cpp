@@ -1,30 +1,53 @@
 #include "simple_synth.h"
+#include "dsp_dispatch.h"
+#include "plugin_state.h"
 // #include "ui.h"  // Disabled for now
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <algorithm>
 
+namespace {
+
+bool is_param_value(const clap_event_header_t* event) {
+    return event->space_id == CLAP_CORE_EVENT_SPACE_ID && event->type == CLAP_EVENT_PARAM_VALUE;
+}
+
+} // namespace
+
 SimpleSynth::SimpleSynth(const clap_host_t* host)
     : host_(host)
     , sample_rate_(44100.0)
     , is_active_(false)
     , is_processing_(false)
-    , attack_(0.01)
-    , decay_(0.1)
-    , sustain_(0.7)
-    , release_(0.3)
-    , volume_(0.8)
-    , waveform_(0.0)
-    , next_voice_index_(0)
+    , pending_param_count_(0)
+    , volume_smoothed_(PARAMS[PARAM_VOLUME].default_value)
+    , host_thread_pool_(nullptr)
+    , host_log_(nullptr)
+    , host_params_(nullptr)
 {
-    voices_.reserve(MAX_VOICES);
-    for (int i = 0; i < MAX_VOICES; ++i) {
-        voices_.push_back(std::make_unique<Voice>());
+    for (double& bend : pitch_bend_) {
+        bend = 0.0;
+    }
+    for (clap_id index = 0; index < PARAM_COUNT; ++index) {
+        params_[index].value = PARAMS[index].default_value;
+        params_[index].descriptor = &PARAMS[index];
+        params_[index].pending_value = 0.0;
+        params_[index].pending = false;
+        param_store_.publish(PARAMS[index].id, params_[index].value);
     }
 }
 
 SimpleSynth::~SimpleSynth() = default;
 
 bool SimpleSynth::init() {
+    // Optional; without it the voices render on the audio thread
+    host_thread_pool_ = static_cast<const clap_host_thread_pool_t*>(
+        host_->get_extension(host_, CLAP_EXT_THREAD_POOL));
+    host_log_ = static_cast<const clap_host_log_t*>(host_->get_extension(host_, CLAP_EXT_LOG));
+    host_params_ = static_cast<const clap_host_params_t*>(host_->get_extension(host_, CLAP_EXT_PARAMS));
+    
     // Create UI (disabled for now)
     // ui_ = std::make_unique<SimpleSynthUI>(this, host_);
     return true;
@@ -38,13 +61,42 @@ bool SimpleSynth::activate(double sample_rate, uint32_t min_frames, uint32_t max
     sample_rate_ = sample_rate;
     is_active_ = true;
     
-    // Filter removed for now
+    // The voices run at the oversampled rate. Only rebuilds the phase
+    // increments if that rate actually changed.
+    const int factor = oversampling_factor();
+    note_table_.set_sample_rate(sample_rate_ * factor);
+    oversampler_.set_factor(factor, max_frames);
+    oversampler_.set_quality(static_cast<int>(param(PARAM_OVERSAMPLING_QUALITY)));
+    
+    // The whole voice pool is allocated here, never while processing
+    voices_.set_capacity(static_cast<int>(param(PARAM_POLYPHONY)), max_frames * factor);
+    
+    // Without a host thread pool, bring our own workers if the voice count
+    // can be split into several tasks at all
+    const int workers = std::min(static_cast<int>(std::thread::hardware_concurrency()) - 1,
+                                 voices_.max_tasks() - 1);
+    if (!host_thread_pool_ && workers > 0) {
+        worker_pool_.start(workers, param(PARAM_PIN_WORKER_THREADS) > 0.5);
+    }
+    
+    volume_smoothed_.set_ramp_length(0.02, sample_rate_);
+    volume_smoothed_.reset(param(PARAM_VOLUME));
     
     return true;
 }
 
 void SimpleSynth::deactivate() {
     is_active_ = false;
+    
+    if (worker_pool_.run_count() > 0 && host_log_ && host_log_->log) {
+        char message[160];
+        std::snprintf(message, sizeof(message),
+                      "Voice rendering: %d worker threads, %.0f%% average utilization over %llu parallel blocks",
+                      worker_pool_.worker_count(), worker_pool_.average_utilization() * 100.0,
+                      static_cast<unsigned long long>(worker_pool_.run_count()));
+        host_log_->log(host_, CLAP_LOG_INFO, message);
+    }
+    worker_pool_.stop();
 }
 
 bool SimpleSynth::start_processing() {
@@ -57,11 +109,10 @@ void SimpleSynth::stop_processing() {
 }
 
 void SimpleSynth::reset() {
-    for (auto& voice : voices_) {
-        voice->note_off();
+    for (Voice& voice : voices_) {
+        voice.note_off();
     }
-    
-    // Filter removed for now
+    oversampler_.reset();
 }
 
 clap_process_status SimpleSynth::process(const clap_process_t* process) {
@@ -69,150 +120,416 @@ clap_process_status SimpleSynth::process(const clap_process_t* process) {
         return CLAP_PROCESS_SLEEP;
     }
 
-    // Process input events
-    process_events(process->in_events);
-
     // Get audio output buffer
-    float* output_left = process->audio_outputs[0].data32[0];
-    float* output_right = process->audio_outputs[0].data32[1];
+    clap_audio_buffer_t& output = process->audio_outputs[0];
+    float* output_left = output.data32[0];
+    float* output_right = output.data32[1];
     uint32_t frame_count = process->frames_count;
 
+    // A new patch, then edits from the editor, apply before the host's
+    // events
+    apply_pending_patch();
+    apply_editor_changes(process->out_events);
+
+    const clap_input_events_t* events = process->in_events;
+    const uint32_t event_count = events->size(events);
+
+    // Nothing sounding and nothing to start: hand the host a constant
+    // silent block and let it put us (and everything downstream) to sleep
+    if (event_count == 0 && voices_.is_idle()) {
+        std::memset(output_left, 0, frame_count * sizeof(float));
+        std::memset(output_right, 0, frame_count * sizeof(float));
+        output.constant_mask = 0x3;
+        return CLAP_PROCESS_SLEEP;
+    }
+    output.constant_mask = 0;
+
     // Clear output buffer
     std::memset(output_left, 0, frame_count * sizeof(float));
-    std::memset(output_right, 0, frame_count * sizeof(float));
 
-    // Process voices
-    for (uint32_t frame = 0; frame < frame_count; ++frame) {
-        double sample = 0.0;
-        
-        for (auto& voice : voices_) {
-            if (voice->is_active()) {
-                sample += voice->process();
+    // Split the block at note event timestamps so every note lands on its
+    // frame. Parameter changes only end a sub-block on the PARAM_INTERVAL
+    // grid: they are staged when reached and applied together at the first
+    // grid line at or after their timestamp, so dense automation costs one
+    // update per parameter and grid step rather than one render per event,
+    // and never plays ahead of time.
+    uint32_t event_index = 0;
+    uint32_t note_index = 0;    // First event from event_index on that is not a parameter value
+    uint32_t frame = 0;
+
+    while (frame < frame_count) {
+        while (event_index < event_count) {
+            const clap_event_header_t* event = events->get(events, event_index);
+            if (event->time > frame) {
+                break;
             }
+            handle_event(event);
+            ++event_index;
         }
-        
-        sample *= volume_;
-        
-        // Apply to both channels (mono to stereo)
-        output_left[frame] = static_cast<float>(sample);
-        output_right[frame] = static_cast<float>(sample);
+        if (frame % PARAM_INTERVAL == 0) {
+            apply_pending_params();
+        }
+
+        // The next note event, skipping the parameter values before it
+        note_index = std::max(note_index, event_index);
+        while (note_index < event_count && is_param_value(events->get(events, note_index))) {
+            ++note_index;
+        }
+        uint32_t next_frame = frame_count;
+        if (note_index < event_count) {
+            next_frame = std::min(next_frame, events->get(events, note_index)->time);
+        }
+        // The grid line the next staged or upcoming value is due on
+        uint32_t param_time = UINT32_MAX;
+        if (pending_param_count_ > 0) {
+            param_time = frame + 1;
+        } else if (event_index < note_index) {
+            param_time = events->get(events, event_index)->time;
+        }
+        if (param_time != UINT32_MAX) {
+            const uint32_t grid_line = (param_time + PARAM_INTERVAL - 1) / PARAM_INTERVAL * PARAM_INTERVAL;
+            next_frame = std::min(next_frame, grid_line);
+        }
+
+        render(output_left + frame, output_right + frame, next_frame - frame);
+        frame = next_frame;
     }
 
+    // Events stamped past the end of the block still apply
+    for (; event_index < event_count; ++event_index) {
+        handle_event(events->get(events, event_index));
+    }
+    apply_pending_params();
+
+    // The last voice finished in this block; the host wakes us up again
+    // with the next event
+    if (voices_.is_idle()) {
+        return CLAP_PROCESS_SLEEP;
+    }
     return CLAP_PROCESS_CONTINUE;
 }
 
+void SimpleSynth::render(float* output_left, float* output_right, uint32_t frame_count) {
+    // Render all voices straight into the mix, or into the oversampled
+    // buffer and decimate that into the mix
+    const uint32_t factor = static_cast<uint32_t>(oversampler_.factor());
+    float* voice_out = output_left;
+    if (factor > 1) {
+        voice_out = oversampler_.buffer();
+        std::memset(voice_out, 0, frame_count * factor * sizeof(float));
+    }
+    const int tasks = voices_.begin_render(voice_out, frame_count * factor);
+    const bool pooled = tasks > 1 && host_thread_pool_ && host_thread_pool_->request_exec
+                        && host_thread_pool_->request_exec(host_, tasks);
+    if (!pooled) {
+        // Runs the tasks in a plain loop when no workers were started
+        worker_pool_.run(tasks, [](void* bank, int task) {
+            static_cast<VoiceBank*>(bank)->render_task(task);
+        }, &voices_);
+    }
+    voices_.end_render();
+    if (factor > 1) {
+        oversampler_.decimate(output_left, frame_count);
+    }
+
+    // Apply volume and copy to both channels (mono to stereo), one linear
+    // volume segment at a time
+    uint32_t frame = 0;
+    while (frame < frame_count) {
+        float gain, gain_increment;
+        const uint32_t frames = volume_smoothed_.next_segment(frame_count - frame, &gain, &gain_increment);
+        dsp_kernels().mix_stereo(output_left + frame, gain, gain_increment,
+                                 output_left + frame, output_right + frame, frames);
+        frame += frames;
+    }
+}
+
+void SimpleSynth::thread_pool_exec(uint32_t task_index) {
+    voices_.render_task(static_cast<int>(task_index));
+}
+
 void SimpleSynth::process_events(const clap_input_events_t* events) {
     uint32_t event_count = events->size(events);
     
     for (uint32_t i = 0; i < event_count; ++i) {
-        const clap_event_header_t* event = events->get(events, i);
+        handle_event(events->get(events, i));
+    }
+    apply_pending_params();
+}
+
+void SimpleSynth::handle_event(const clap_event_header_t* event) {
+    if (event->space_id != CLAP_CORE_EVENT_SPACE_ID) {
+        return;
+    }
+    // Notes and MIDI see the parameter values that precede them
+    if (event->type != CLAP_EVENT_PARAM_VALUE) {
+        apply_pending_params();
+    }
+    
+    switch (event->type) {
+        case CLAP_EVENT_NOTE_ON: {
+            const clap_event_note_t* note_event = 
+                reinterpret_cast<const clap_event_note_t*>(event);
+            handle_note_on(note_key(note_event->note_id, note_event->port_index,
+                                    note_event->channel, note_event->key),
+                           note_event->velocity);
+            break;
+        }
         
-        switch (event->type) {
-            case CLAP_EVENT_NOTE_ON: {
-                const clap_event_note_t* note_event = 
-                    reinterpret_cast<const clap_event_note_t*>(event);
-                handle_note_on(note_event->key, note_event->velocity);
-                break;
-            }
+        case CLAP_EVENT_NOTE_OFF: {
+            const clap_event_note_t* note_event = 
+                reinterpret_cast<const clap_event_note_t*>(event);
+            handle_note_off(note_key(note_event->note_id, note_event->port_index,
+                                     note_event->channel, note_event->key));
+            break;
+        }
+        
+        case CLAP_EVENT_NOTE_EXPRESSION: {
+            const clap_event_note_expression_t* expression_event = 
+                reinterpret_cast<const clap_event_note_expression_t*>(event);
+            handle_note_expression(note_key(expression_event->note_id, expression_event->port_index,
+                                            expression_event->channel, expression_event->key),
+                                   expression_event->expression_id, expression_event->value);
+            break;
+        }
+        
+        case CLAP_EVENT_MIDI: {
+            // Handle MIDI events (Bitwig might send these instead of CLAP note events)
+            const clap_event_midi_t* midi_event = 
+                reinterpret_cast<const clap_event_midi_t*>(event);
             
-            case CLAP_EVENT_NOTE_OFF: {
-                const clap_event_note_t* note_event = 
-                    reinterpret_cast<const clap_event_note_t*>(event);
-                handle_note_off(note_event->key);
-                break;
-            }
+            uint8_t status = midi_event->data[0];
+            uint8_t channel = status & 0x0F;
+            uint8_t note = midi_event->data[1];
+            uint8_t velocity = midi_event->data[2];
+            const NoteKey key = note_key(-1, midi_event->port_index, channel, note);
             
-            case CLAP_EVENT_MIDI: {
-                // Handle MIDI events (Bitwig might send these instead of CLAP note events)
-                const clap_event_midi_t* midi_event = 
-                    reinterpret_cast<const clap_event_midi_t*>(event);
-                
-                uint8_t status = midi_event->data[0];
-                uint8_t note = midi_event->data[1];
-                uint8_t velocity = midi_event->data[2];
-                
-                if ((status & 0xF0) == 0x90 && velocity > 0) {
-                    // Note On
-                    handle_note_on(note, velocity / 127.0);
-                } else if ((status & 0xF0) == 0x80 || ((status & 0xF0) == 0x90 && velocity == 0)) {
-                    // Note Off - make sure we handle this properly
-                    handle_note_off(note);
-                }
-                break;
+            if ((status & 0xF0) == 0x90 && velocity > 0) {
+                // Note On
+                handle_note_on(key, velocity / 127.0);
+            } else if ((status & 0xF0) == 0x80 || ((status & 0xF0) == 0x90 && velocity == 0)) {
+                // Note Off - make sure we handle this properly
+                handle_note_off(key);
+            } else if ((status & 0xF0) == 0xE0) {
+                // Pitch bend, 14-bit value centered at 8192, +/- 2 semitones.
+                // Bend is per channel so MPE controllers can bend single notes.
+                const int bend = ((midi_event->data[2] << 7) | midi_event->data[1]) - 8192;
+                handle_pitch_bend(channel, bend / 8192.0 * 2.0);
             }
+            break;
+        }
+        
+        case CLAP_EVENT_PARAM_VALUE: {
+            const clap_event_param_value_t* param_event = 
+                reinterpret_cast<const clap_event_param_value_t*>(event);
             
-            case CLAP_EVENT_PARAM_VALUE: {
-                const clap_event_param_value_t* param_event = 
-                    reinterpret_cast<const clap_event_param_value_t*>(event);
-                
-                switch (param_event->param_id) {
-                    case PARAM_ATTACK:
-                        attack_ = param_event->value;
-                        break;
-                    case PARAM_DECAY:
-                        decay_ = param_event->value;
-                        break;
-                    case PARAM_SUSTAIN:
-                        sustain_ = param_event->value;
-                        break;
-                    case PARAM_RELEASE:
-                        release_ = param_event->value;
-                        break;
-                    case PARAM_VOLUME:
-                        volume_ = param_event->value;
-                        break;
-                    case PARAM_WAVEFORM:
-                        waveform_ = param_event->value;
-                        break;
+            // Hosts pass back the cookie from params_get_info(), or null
+            ParamSlot* slot = static_cast<ParamSlot*>(param_event->cookie);
+            if (!slot) {
+                if (param_event->param_id >= PARAM_COUNT) {
+                    break;
                 }
-                break;
+                slot = &params_[param_event->param_id];
             }
+            stage_param(*slot, param_event->value);
+            break;
         }
     }
 }
 
-void SimpleSynth::handle_note_on(int note, double velocity) {
-    Voice* voice = get_free_voice();
-    if (voice) {
-        voice->set_adsr(attack_, decay_, sustain_, release_);
-        voice->set_waveform(static_cast<int>(waveform_));
-        voice->note_on(note, velocity, sample_rate_);
-    }
+void SimpleSynth::apply_param(ParamSlot& slot, double value) {
+    run_param_updates(1u << store_param(slot, value));
 }
 
-void SimpleSynth::handle_note_off(int note) {
-    // Turn off ALL voices playing this note (in case of duplicates)
-    for (auto& voice : voices_) {
-        if (voice->is_active() && voice->get_note() == note) {
-            voice->note_off();
+ParamUpdate SimpleSynth::store_param(ParamSlot& slot, double value) {
+    const ParamDescriptor& descriptor = *slot.descriptor;
+    slot.value = descriptor.constrain(value);
+    param_store_.publish(descriptor.id, slot.value);
+    return descriptor.update;
+}
+
+void SimpleSynth::run_param_updates(uint32_t updates) {
+    // One bit per ParamUpdate, so several changes of a kind cost one update
+    if (updates & (1u << UPDATE_VOLUME)) {
+        volume_smoothed_.set_target(param(PARAM_VOLUME));
+    }
+    if (updates & (1u << UPDATE_FILTERS)) {
+        update_filters();
+    }
+    if (updates & (1u << UPDATE_VOICE_STEALING)) {
+        voices_.set_steal_policy(static_cast<StealPolicy>(static_cast<int>(param(PARAM_VOICE_STEALING))));
+    }
+    if (updates & (1u << UPDATE_POLYPHONY)) {
+        // Resizing the pool allocates, so ask the host to deactivate and
+        // reactivate us instead of doing it here
+        if (is_active_ && static_cast<int>(param(PARAM_POLYPHONY)) != voices_.capacity()) {
+            host_->request_restart(host_);
+        }
+    }
+    if (updates & (1u << UPDATE_OVERSAMPLING)) {
+        // The voice pool and the oversampled buffer are sized for the factor
+        if (is_active_ && oversampling_factor() != oversampler_.factor()) {
+            host_->request_restart(host_);
         }
     }
+    if (updates & (1u << UPDATE_WORKER_PINNING)) {
+        // Affinity is set when the workers start
+        const bool pin = param(PARAM_PIN_WORKER_THREADS) > 0.5;
+        if (is_active_ && worker_pool_.worker_count() > 0 && pin != worker_pool_.pinned()) {
+            host_->request_restart(host_);
+        }
+    }
+    if (updates & (1u << UPDATE_OVERSAMPLING_QUALITY)) {
+        oversampler_.set_quality(static_cast<int>(param(PARAM_OVERSAMPLING_QUALITY)));
+    }
 }
 
-Voice* SimpleSynth::find_voice_for_note(int note) {
-    // Find the most recent voice playing this note
-    Voice* found_voice = nullptr;
-    for (auto& voice : voices_) {
-        if (voice->is_active() && voice->get_note() == note) {
-            found_voice = voice.get();
-            // Don't break - keep looking for the most recent one
+void SimpleSynth::stage_param(ParamSlot& slot, double value) {
+    // Constant work per event: a later value simply replaces this one
+    if (!slot.pending) {
+        slot.pending = true;
+        pending_params_[pending_param_count_++] = &slot;
+    }
+    slot.pending_value = value;
+}
+
+void SimpleSynth::apply_pending_params() {
+    uint32_t updates = 0;
+    for (uint32_t i = 0; i < pending_param_count_; ++i) {
+        ParamSlot& slot = *pending_params_[i];
+        slot.pending = false;
+        updates |= 1u << store_param(slot, slot.pending_value);
+    }
+    pending_param_count_ = 0;
+    run_param_updates(updates);
+}
+
+void SimpleSynth::apply_patch(const Patch& patch) {
+    uint32_t updates = 0;
+    for (clap_id param_id = 0; param_id < PARAM_COUNT; ++param_id) {
+        updates |= 1u << store_param(params_[param_id], patch.value(static_cast<ParamId>(param_id)));
+    }
+    run_param_updates(updates);
+}
+
+void SimpleSynth::apply_pending_patch() {
+    const Patch* patch = patches_.begin();
+    if (!patch) {
+        return;
+    }
+    // param_store_ has every value before the patch stops being pending, so
+    // state_save() never falls between the two
+    apply_patch(*patch);
+    // Freed on the main thread, never here
+    patches_.finish(patch);
+    host_->request_callback(host_);
+}
+
+void SimpleSynth::apply_editor_changes(const clap_output_events_t* out) {
+    ParamEvent event;
+    while (param_store_.receive_on_audio(&event)) {
+        if (event.type == ParamEvent::VALUE) {
+            apply_param(params_[event.param_id], event.value);
+            
+            // Tell the host, so it records the edit
+            clap_event_param_value_t value_event = {};
+            value_event.header.size = sizeof(value_event);
+            value_event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+            value_event.header.type = CLAP_EVENT_PARAM_VALUE;
+            value_event.param_id = event.param_id;
+            value_event.note_id = -1;
+            value_event.port_index = -1;
+            value_event.channel = -1;
+            value_event.key = -1;
+            value_event.value = param_store_.value(event.param_id);
+            out->try_push(out, &value_event.header);
+        } else {
+            clap_event_param_gesture_t gesture_event = {};
+            gesture_event.header.size = sizeof(gesture_event);
+            gesture_event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+            gesture_event.header.type = event.type == ParamEvent::GESTURE_BEGIN
+                ? CLAP_EVENT_PARAM_GESTURE_BEGIN : CLAP_EVENT_PARAM_GESTURE_END;
+            gesture_event.param_id = event.param_id;
+            out->try_push(out, &gesture_event.header);
         }
     }
-    return found_voice;
 }
 
-Voice* SimpleSynth::get_free_voice() {
-    // First, try to find an inactive voice
-    for (auto& voice : voices_) {
-        if (!voice->is_active()) {
-            return voice.get();
+NoteKey SimpleSynth::note_key(int32_t note_id, int16_t port, int16_t channel, int16_t key) {
+    NoteKey note;
+    note.note_id = note_id;
+    note.port = port;
+    note.channel = channel;
+    note.key = key;
+    return note;
+}
+
+void SimpleSynth::handle_note_on(const NoteKey& key, double velocity) {
+    if (key.key < 0 || key.key >= note_tables::NOTE_COUNT) {
+        return;
+    }
+    
+    Voice* voice = get_free_voice(key);
+    if (voice) {
+        voice->set_adsr(param(PARAM_ATTACK), param(PARAM_DECAY), param(PARAM_SUSTAIN), param(PARAM_RELEASE));
+        voice->set_waveform(static_cast<int>(param(PARAM_WAVEFORM)));
+        voice->set_filter(param(PARAM_FILTER_CUTOFF), param(PARAM_FILTER_RESONANCE),
+                          param(PARAM_FILTER_ENV_AMOUNT), param(PARAM_FILTER_KEY_TRACK));
+        voice->set_pitch_bend(key.channel >= 0 ? pitch_bend_[key.channel & 0x0F] : 0.0);
+        voice->note_on(key.key, velocity, note_table_);
+        voices_.assign_note(voice, key);
+    }
+}
+
+void SimpleSynth::handle_pitch_bend(int channel, double semitones) {
+    pitch_bend_[channel] = semitones;
+    
+    NoteKey pattern;
+    pattern.channel = static_cast<int16_t>(channel);
+    voices_.for_each_note(pattern, [&](Voice& voice) {
+        voice.set_pitch_bend(semitones);
+    });
+}
+
+void SimpleSynth::handle_note_off(const NoteKey& key) {
+    // Turn off ALL voices playing this note (in case of duplicates)
+    voices_.for_each_note(key, [](Voice& voice) {
+        voice.note_off();
+    });
+}
+
+void SimpleSynth::handle_note_expression(const NoteKey& key, int expression_id, double value) {
+    voices_.for_each_note(key, [&](Voice& voice) {
+        switch (expression_id) {
+            case CLAP_NOTE_EXPRESSION_TUNING:
+                voice.set_tuning(value);
+                break;
+            case CLAP_NOTE_EXPRESSION_VOLUME:
+                voice.set_volume(value);
+                break;
         }
+    });
+}
+
+Voice* SimpleSynth::get_free_voice(const NoteKey& key) {
+    // First, try to take an inactive voice
+    if (Voice* voice = voices_.allocate()) {
+        return voice;
     }
     
-    // If no free voice, steal the oldest one (round-robin)
-    Voice* voice = voices_[next_voice_index_].get();
-    next_voice_index_ = (next_voice_index_ + 1) % MAX_VOICES;
-    return voice;
+    // If no free voice, steal one according to the stealing policy
+    return voices_.steal(key);
+}
+
+int SimpleSynth::oversampling_factor() const {
+    return 1 << static_cast<int>(param(PARAM_OVERSAMPLING));
+}
+
+void SimpleSynth::update_filters() {
+    for (Voice& voice : voices_) {
+        voice.set_filter(param(PARAM_FILTER_CUTOFF), param(PARAM_FILTER_RESONANCE),
+                         param(PARAM_FILTER_ENV_AMOUNT), param(PARAM_FILTER_KEY_TRACK));
+    }
 }
 
 // Parameter interface implementation
@@ -225,132 +542,121 @@ bool SimpleSynth::params_get_info(uint32_t param_index, clap_param_info_t* param
         return false;
     }
     
-    switch (param_index) {
-        case PARAM_ATTACK:
-            param_info->id = PARAM_ATTACK;
-            std::strcpy(param_info->name, "Attack");
-            std::strcpy(param_info->module, "Envelope");
-            param_info->min_value = 0.001;
-            param_info->max_value = 5.0;
-            param_info->default_value = 0.01;
-            param_info->flags = CLAP_PARAM_IS_AUTOMATABLE;
-            break;
-            
-        case PARAM_DECAY:
-            param_info->id = PARAM_DECAY;
-            std::strcpy(param_info->name, "Decay");
-            std::strcpy(param_info->module, "Envelope");
-            param_info->min_value = 0.001;
-            param_info->max_value = 5.0;
-            param_info->default_value = 0.1;
-            param_info->flags = CLAP_PARAM_IS_AUTOMATABLE;
-            break;
-            
-        case PARAM_SUSTAIN:
-            param_info->id = PARAM_SUSTAIN;
-            std::strcpy(param_info->name, "Sustain");
-            std::strcpy(param_info->module, "Envelope");
-            param_info->min_value = 0.0;
-            param_info->max_value = 1.0;
-            param_info->default_value = 0.7;
-            param_info->flags = CLAP_PARAM_IS_AUTOMATABLE;
-            break;
-            
-        case PARAM_RELEASE:
-            param_info->id = PARAM_RELEASE;
-            std::strcpy(param_info->name, "Release");
-            std::strcpy(param_info->module, "Envelope");
-            param_info->min_value = 0.001;
-            param_info->max_value = 5.0;
-            param_info->default_value = 0.3;
-            param_info->flags = CLAP_PARAM_IS_AUTOMATABLE;
-            break;
-            
-        case PARAM_VOLUME:
-            param_info->id = PARAM_VOLUME;
-            std::strcpy(param_info->name, "Volume");
-            std::strcpy(param_info->module, "Main");
-            param_info->min_value = 0.0;
-            param_info->max_value = 1.0;
-            param_info->default_value = 0.8;
-            param_info->flags = CLAP_PARAM_IS_AUTOMATABLE;
-            break;
-            
-        case PARAM_WAVEFORM:
-            param_info->id = PARAM_WAVEFORM;
-            std::strcpy(param_info->name, "Waveform");
-            std::strcpy(param_info->module, "Oscillator");
-            param_info->min_value = 0.0;
-            param_info->max_value = 4.0;
-            param_info->default_value = 0.0;
-            param_info->flags = CLAP_PARAM_IS_AUTOMATABLE | CLAP_PARAM_IS_STEPPED;
-            break;
-    }
+    const ParamDescriptor& param = PARAMS[param_index];
+    param_info->id = param.id;
+    param_info->flags = param.flags;
+    param_info->cookie = &params_[param_index];
+    std::snprintf(param_info->name, sizeof(param_info->name), "%s", param.name);
+    std::snprintf(param_info->module, sizeof(param_info->module), "%s", param.module);
+    param_info->min_value = param.min_value;
+    param_info->max_value = param.max_value;
+    param_info->default_value = param.default_value;
     
     return true;
 }
 
 bool SimpleSynth::params_get_value(clap_id param_id, double* value) {
-    switch (param_id) {
-        case PARAM_ATTACK:
-            *value = attack_;
-            return true;
-        case PARAM_DECAY:
-            *value = decay_;
-            return true;
-        case PARAM_SUSTAIN:
-            *value = sustain_;
-            return true;
-        case PARAM_RELEASE:
-            *value = release_;
-            return true;
-        case PARAM_VOLUME:
-            *value = volume_;
-            return true;
-        case PARAM_WAVEFORM:
-            *value = waveform_;
-            return true;
-        default:
-            return false;
+    // Any thread: the values the audio thread last applied
+    if (param_id >= PARAM_COUNT) {
+        return false;
     }
+    *value = param_store_.value(param_id);
+    return true;
 }
 
 bool SimpleSynth::params_value_to_text(clap_id param_id, double value, char* display, uint32_t size) {
-    switch (param_id) {
-        case PARAM_ATTACK:
-        case PARAM_DECAY:
-        case PARAM_RELEASE:
-            std::snprintf(display, size, "%.3f s", value);
-            return true;
-        case PARAM_SUSTAIN:
-        case PARAM_VOLUME:
-            std::snprintf(display, size, "%.1f%%", value * 100.0);
-            return true;
-        case PARAM_WAVEFORM: {
-            const char* waveforms[] = {"Sine", "Square", "Saw", "Triangle", "Pulse"};
-            int wave_index = static_cast<int>(value);
-            if (wave_index >= 0 && wave_index < 5) {
-                std::strcpy(display, waveforms[wave_index]);
-            } else {
-                std::strcpy(display, "Sine");
-            }
-            return true;
-        }
-        default:
-            return false;
+    if (param_id >= PARAM_COUNT) {
+        return false;
     }
+    PARAMS[param_id].format(PARAMS[param_id], value, display, size);
+    return true;
 }
 
 bool SimpleSynth::params_text_to_value(clap_id param_id, const char* display, double* value) {
-    // Simple implementation - just parse the number
-    *value = std::atof(display);
-    return true;
+    if (param_id >= PARAM_COUNT) {
+        return false;
+    }
+    return PARAMS[param_id].parse(PARAMS[param_id], display, value);
 }
 
 void SimpleSynth::params_flush(const clap_input_events_t* in, const clap_output_events_t* out) {
+    // Audio thread while active, main thread otherwise; never concurrent
+    // with process()
+    apply_pending_patch();
+    apply_editor_changes(out);
     process_events(in);
 }
 
+void SimpleSynth::begin_param_gesture(clap_id param_id) {
+    send_editor_event(ParamEvent{ParamEvent::GESTURE_BEGIN, param_id, 0.0});
+}
+
+void SimpleSynth::set_param_from_editor(clap_id param_id, double value) {
+    send_editor_event(ParamEvent{ParamEvent::VALUE, param_id, value});
+}
+
+void SimpleSynth::end_param_gesture(clap_id param_id) {
+    send_editor_event(ParamEvent{ParamEvent::GESTURE_END, param_id, 0.0});
+}
+
+bool SimpleSynth::poll_param_change(clap_id* param_id, double* value) {
+    return param_store_.receive_on_main(param_id, value);
+}
+
+void SimpleSynth::send_editor_event(const ParamEvent& event) {
+    if (event.param_id >= PARAM_COUNT || !param_store_.send_to_audio(event)) {
+        return;
+    }
+    // The host answers with process() or flush(), which apply it
+    if (host_params_ && host_params_->request_flush) {
+        host_params_->request_flush(host_);
+    }
+}
+
+void SimpleSynth::load_patch(std::unique_ptr<Patch> patch) {
+    if (!is_active_) {
+        // We own the parameters while inactive
+        patches_.discard();
+        patches_.collect();
+        apply_patch(*patch);
+        return;
+    }
+
+    // One swap hands over every value
+    patches_.publish(patch.release());
+    if (host_params_ && host_params_->request_flush) {
+        host_params_->request_flush(host_);
+    }
+}
+
+void SimpleSynth::on_main_thread() {
+    patches_.collect();
+}
+
+bool SimpleSynth::state_save(const clap_ostream_t* stream) {
+    // What the audio thread applied, unless a new patch is still on its
+    // way there
+    Patch patch;
+    if (const Patch* pending = patches_.pending()) {
+        patch = *pending;
+    } else {
+        for (clap_id param_id = 0; param_id < PARAM_COUNT; ++param_id) {
+            patch.set_value(static_cast<ParamId>(param_id), param_store_.value(param_id));
+        }
+    }
+    return plugin_state::save(stream, patch);
+}
+
+bool SimpleSynth::state_load(const clap_istream_t* stream) {
+    // Parse and validate here, before anything reaches the audio thread
+    std::unique_ptr<Patch> patch(new Patch);
+    if (!plugin_state::load(stream, patch.get())) {
+        return false;
+    }
+    load_patch(std::move(patch));
+    return true;
+}
+
 // Note ports
 uint32_t SimpleSynth::note_ports_count(bool is_input) {
     return is_input ? 1 : 0;
@@ -363,8 +669,8 @@ bool SimpleSynth::note_ports_get(uint32_t index, bool is_input, clap_note_port_i
     
     info->id = 0;
     std::strcpy(info->name, "Note Input");
-    info->supported_dialects = CLAP_NOTE_DIALECT_MIDI;
-    info->preferred_dialect = CLAP_NOTE_DIALECT_MIDI;
+    info->supported_dialects = CLAP_NOTE_DIALECT_CLAP | CLAP_NOTE_DIALECT_MIDI;
+    info->preferred_dialect = CLAP_NOTE_DIALECT_CLAP;
     
     return true;
 }
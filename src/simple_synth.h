@@ -1,9 +1,15 @@
 #pragma once
 
-#include <clap/clap.h>
-#include <vector>
 #include <memory>
-#include "voice.h"
+#include <clap/clap.h>
+#include "note_table.h"
+#include "oversampler.h"
+#include "param_store.h"
+#include "params.h"
+#include "patch.h"
+#include "smoothed_value.h"
+#include "voice_bank.h"
+#include "worker_pool.h"
 
 class SimpleSynthUI;
 
@@ -22,7 +28,14 @@ public:
     void reset();
     clap_process_status process(const clap_process_t* process);
 
-    // Parameters
+    // Thread pool: renders one group of voices, called from the host's
+    // worker threads while process() waits in request_exec()
+    void thread_pool_exec(uint32_t task_index);
+
+    // Built-in worker pool used when the host has no thread pool
+    const WorkerPool& worker_pool() const { return worker_pool_; }
+
+    // Parameters. params_get_value() may be called from any thread.
     uint32_t params_count();
     bool params_get_info(uint32_t param_index, clap_param_info_t* param_info);
     bool params_get_value(clap_id param_id, double* value);
@@ -30,6 +43,27 @@ public:
     bool params_text_to_value(clap_id param_id, const char* display, double* value);
     void params_flush(const clap_input_events_t* in, const clap_output_events_t* out);
 
+    // Editor edits, main thread only. They reach the audio thread at its
+    // next process() or flush(), which also reports them to the host.
+    void begin_param_gesture(clap_id param_id);
+    void set_param_from_editor(clap_id param_id, double value);
+    void end_param_gesture(clap_id param_id);
+    // Next parameter the audio thread applied a value to, from either side,
+    // with its latest value; main thread only
+    bool poll_param_change(clap_id* param_id, double* value);
+
+    // Switch to a whole patch, main thread. While active the audio thread
+    // picks it up in one piece at its next process() or flush(); a patch
+    // it has not picked up by then is replaced.
+    void load_patch(std::unique_ptr<Patch> patch);
+    // The host's callback after request_callback(): frees the patches the
+    // audio thread is done with
+    void on_main_thread();
+
+    // State, main thread. Loading switches to the stored patch.
+    bool state_save(const clap_ostream_t* stream);
+    bool state_load(const clap_istream_t* stream);
+
     // Note ports
     uint32_t note_ports_count(bool is_input);
     bool note_ports_get(uint32_t index, bool is_input, clap_note_port_info_t* info);
@@ -42,42 +76,87 @@ public:
     // SimpleSynthUI* get_ui() { return ui_.get(); }
 
 private:
-    enum ParamIds {
-        PARAM_ATTACK = 0,
-        PARAM_DECAY,
-        PARAM_SUSTAIN,
-        PARAM_RELEASE,
-        PARAM_VOLUME,
-        PARAM_WAVEFORM,
-        PARAM_COUNT
+    // A parameter's current value. params_get_info() hands its address to
+    // the host as the cookie, so value events find it without a lookup.
+    struct ParamSlot {
+        double value;
+        const ParamDescriptor* descriptor;
+        // Latest value from the host not yet applied
+        double pending_value;
+        bool pending;
     };
 
+    // Host parameter changes are applied on a grid of this many frames of
+    // the block, the last value per parameter winning, instead of splitting
+    // the block at every automation point. A change takes effect on the
+    // first grid line at or after its timestamp, so up to PARAM_INTERVAL - 1
+    // frames late, never early. Values still pending at the end of the block
+    // apply before the next one.
+    static constexpr uint32_t PARAM_INTERVAL = VoiceLanes::CONTROL_INTERVAL;
+
     const clap_host_t* host_;
     double sample_rate_;
     bool is_active_;
     bool is_processing_;
 
-    // Parameters
-    double attack_;
-    double decay_;
-    double sustain_;
-    double release_;
-    double volume_;
-    double waveform_;
+    // Parameters, owned by the audio thread (the main thread while
+    // inactive). Polyphony and Oversampling take effect on the next
+    // activate().
+    ParamSlot params_[PARAM_COUNT];
+    // Slots with a pending value, in the order they were first changed
+    ParamSlot* pending_params_[PARAM_COUNT];
+    uint32_t pending_param_count_;
+
+    // What the other threads see of them
+    ParamStore<PARAM_COUNT> param_store_;
+
+    // Patches on their way to the audio thread and back
+    PatchExchange patches_;
 
-    // Filter removed for now
+    // Volume as heard, gliding towards the Volume parameter
+    SmoothedValue volume_smoothed_;
+
+    // MIDI pitch bend per channel, in semitones
+    double pitch_bend_[16];
+
+    // Note to phase increment tables for the current sample rate
+    NoteTable note_table_;
 
     // Voice management
-    static constexpr int MAX_VOICES = 16;
-    std::vector<std::unique_ptr<Voice>> voices_;
-    int next_voice_index_;
+    VoiceBank voices_;
+    // Voices render at the oversampled rate into its buffer
+    Oversampler oversampler_;
+
+    // Host worker threads for voice rendering, null if not offered
+    const clap_host_thread_pool_t* host_thread_pool_;
+    // Our own workers otherwise, started in activate() and pinned to one
+    // core each if the Pin Worker Threads parameter says so (Linux only)
+    WorkerPool worker_pool_;
+    const clap_host_log_t* host_log_;
+    const clap_host_params_t* host_params_;
 
     // UI (disabled for now)
     // std::unique_ptr<SimpleSynthUI> ui_;
 
     void process_events(const clap_input_events_t* events);
-    void handle_note_on(int note, double velocity);
-    void handle_note_off(int note);
-    Voice* find_voice_for_note(int note);
-    Voice* get_free_voice();
+    void handle_event(const clap_event_header_t* event);
+    double param(ParamId param_id) const { return params_[param_id].value; }
+    void apply_param(ParamSlot& slot, double value);
+    ParamUpdate store_param(ParamSlot& slot, double value);
+    void run_param_updates(uint32_t updates);
+    void stage_param(ParamSlot& slot, double value);
+    void apply_pending_params();
+    void apply_patch(const Patch& patch);
+    void apply_pending_patch();
+    void apply_editor_changes(const clap_output_events_t* out);
+    void send_editor_event(const ParamEvent& event);
+    void render(float* output_left, float* output_right, uint32_t frame_count);
+    static NoteKey note_key(int32_t note_id, int16_t port, int16_t channel, int16_t key);
+    void handle_note_on(const NoteKey& key, double velocity);
+    void handle_note_off(const NoteKey& key);
+    void handle_note_expression(const NoteKey& key, int expression_id, double value);
+    void handle_pitch_bend(int channel, double semitones);
+    int oversampling_factor() const;
+    void update_filters();
+    Voice* get_free_voice(const NoteKey& key);
 };
\ No newline at end of file
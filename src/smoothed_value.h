@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+// Continuous parameter that glides linearly to a new target instead of
+// stepping, to avoid zipper noise under automation. The renderer asks for
+// the value as linear segments, so the ramp is applied inside the block
+// kernels rather than one sample at a time.
+class SmoothedValue {
+public:
+    explicit SmoothedValue(double value = 0.0)
+        : current_(value)
+        , target_(value)
+        , increment_(0.0)
+        , remaining_(0)
+        , ramp_samples_(1)
+    {
+    }
+
+    void set_ramp_length(double seconds, double sample_rate) {
+        ramp_samples_ = std::max<uint32_t>(1, static_cast<uint32_t>(seconds * sample_rate));
+    }
+
+    // Start a ramp from the current value to target
+    void set_target(double target) {
+        target_ = target;
+        increment_ = (target_ - current_) / ramp_samples_;
+        remaining_ = ramp_samples_;
+    }
+
+    // Jump to value without a ramp
+    void reset(double value) {
+        current_ = value;
+        target_ = value;
+        increment_ = 0.0;
+        remaining_ = 0;
+    }
+
+    double target() const { return target_; }
+    bool is_smoothing() const { return remaining_ > 0; }
+
+    // Describe the next linear segment of at most max_frames frames by its
+    // first value and per-frame increment, advance past it and return its
+    // length. A segment never straddles the end of a ramp.
+    uint32_t next_segment(uint32_t max_frames, float* start, float* increment) {
+        *start = static_cast<float>(current_);
+        if (remaining_ == 0) {
+            *increment = 0.0f;
+            return max_frames;
+        }
+
+        const uint32_t frames = std::min(max_frames, remaining_);
+        *increment = static_cast<float>(increment_);
+        remaining_ -= frames;
+        current_ = (remaining_ == 0) ? target_ : current_ + increment_ * frames;
+        return frames;
+    }
+
+private:
+    double current_;
+    double target_;
+    double increment_;
+    uint32_t remaining_;
+    uint32_t ramp_samples_;
+};
@@ -306,7 +306,7 @@ void SimpleSynthUI::setup_slider(NSSlider* &slider, NSTextField* &label, NSTextF
     else if (slider == impl_->sustain_slider_) target.param_id = 2;
     else if (slider == impl_->release_slider_) target.param_id = 3;
     else if (slider == impl_->volume_slider_) target.param_id = 4;
-    else if (slider == impl_->filter_cutoff_slider_) target.param_id = 5;
+    else if (slider == impl_->filter_cutoff_slider_) target.param_id = 8;
     
     [slider setTarget:target];
     [slider setAction:@selector(sliderChanged:)];
@@ -350,7 +350,7 @@ void SimpleSynthUI::update_parameter_display(uint32_t param_id) {
             value_field = impl_->volume_value_;
             slider = impl_->volume_slider_;
             break;
-        case 5: // Filter Cutoff
+        case 8: // Filter Cutoff
             value_field = impl_->filter_cutoff_value_;
             slider = impl_->filter_cutoff_slider_;
             break;
@@ -367,15 +367,9 @@ void SimpleSynthUI::update_parameter_display(uint32_t param_id) {
 }
 
 void SimpleSynthUI::on_parameter_changed(uint32_t param_id, double value) {
-    // Send parameter change to host
-    if (host_ && host_->request_callback) {
-        host_->request_callback(host_);
-    }
+    // Queued for the audio thread, which applies it and tells the host
+    synth_->set_param_from_editor(param_id, value);
     
     // Update display
     update_parameter_display(param_id);
-    
-    // This would normally send a parameter change event to the plugin
-    // For now, we'll directly update the synth (not ideal for real plugins)
-    // In a proper implementation, this should go through the host's parameter system
 }
\ No newline at end of file
@@ -1,38 +1,75 @@
 #include "voice.h"
+#include <algorithm>
 #include <cmath>
 
 Voice::Voice() 
-    : active_(false)
+    : lanes_(nullptr)
+    , lane_(0)
+    , notes_(nullptr)
+    , active_(false)
     , note_(0)
     , velocity_(0.0)
-    , frequency_(440.0)
+    , pitch_bend_(0.0)
+    , tuning_(0.0)
+    , volume_(1.0)
     , sample_rate_(44100.0)
-    , phase_(0.0)
-    , phase_increment_(0.0)
     , env_state_(ENV_IDLE)
-    , env_level_(0.0)
     , attack_time_(0.01)
     , decay_time_(0.1)
     , sustain_level_(0.7)
     , release_time_(0.3)
-    , env_increment_(0.0)
+    , segment_remaining_(NO_BOUNDARY)
+    , segment_target_(0.0f)
     , safety_counter_(0)
     , waveform_(0)
+    , filter_cutoff_(MAX_CUTOFF)
+    , filter_resonance_(0.0)
+    , filter_env_amount_(0.0)
+    , filter_key_track_(0.0)
+    , pitch_changed_(false)
+    , filter_changed_(false)
+    , phase_increment_target_(0)
+    , fading_(false)
 {
 }
 
-void Voice::note_on(int note, double velocity, double sample_rate) {
+void Voice::bind(VoiceLanes* lanes, int lane) {
+    lanes_ = lanes;
+    lane_ = lane;
+    fading_ = false;
+    stop();
+}
+
+void Voice::relocate(int lane) {
+    lanes_->copy_lane(lane_, lane);
+    lane_ = lane;
+}
+
+void Voice::note_on(int note, double velocity, const NoteTable& notes) {
+    notes_ = &notes;
     note_ = note;
     velocity_ = velocity;
-    sample_rate_ = sample_rate;
+    fading_ = false;
+    tuning_ = 0.0;
+    volume_ = 1.0;
+    sample_rate_ = notes.sample_rate();
     active_ = true;
     
-    calculate_frequency();
-    phase_ = 0.0;
-    phase_increment_ = 2.0 * M_PI * frequency_ / sample_rate_;
+    // Start right on pitch, ramps only follow later changes
+    pitch_changed_ = false;
+    filter_changed_ = false;
+    phase_increment_target_ = compute_phase_increment();
+    lanes_->phase_increment[lane_] = phase_increment_target_;
+    lanes_->phase_increment_step[lane_] = 0;
+    lanes_->phase[lane_] = 0;
+    lanes_->gain[lane_] = static_cast<float>(velocity_);
+    lanes_->waveform[lane_] = waveform_;
     
     env_state_ = ENV_ATTACK;
-    env_level_ = 0.0;
+    lanes_->env_level[lane_] = 0.0f;
+    lanes_->filter_ic1[lane_] = 0.0f;
+    lanes_->filter_ic2[lane_] = 0.0f;
+    update_filter(0.0f, 0);
     safety_counter_ = 0;
     update_envelope();
 }
@@ -45,6 +82,17 @@ void Voice::note_off() {
     }
 }
 
+void Voice::fade_out(double seconds) {
+    if (!active_) {
+        return;
+    }
+    fading_ = true;
+    env_state_ = ENV_RELEASE;
+    release_time_ = seconds;
+    safety_counter_ = 0;
+    update_envelope();
+}
+
 void Voice::set_adsr(double attack, double decay, double sustain, double release) {
     attack_time_ = attack;
     decay_time_ = decay;
@@ -57,135 +105,237 @@ void Voice::set_adsr(double attack, double decay, double sustain, double release
 }
 
 void Voice::set_waveform(int waveform) {
-    waveform_ = waveform;
+    waveform_ = (waveform >= 0 && waveform < WAVE_COUNT) ? waveform : WAVE_SINE;
+}
+
+void Voice::set_filter(double cutoff, double resonance, double env_amount, double key_track) {
+    filter_cutoff_ = cutoff;
+    filter_resonance_ = resonance;
+    filter_env_amount_ = env_amount;
+    filter_key_track_ = key_track;
+    filter_changed_ = true;
+}
+
+void Voice::set_pitch_bend(double semitones) {
+    pitch_bend_ = semitones;
+    pitch_changed_ = true;
+}
+
+void Voice::set_tuning(double semitones) {
+    tuning_ = semitones;
+    pitch_changed_ = true;
 }
 
-double Voice::process() {
+void Voice::set_volume(double gain) {
+    volume_ = gain;
+    
+    if (active_) {
+        lanes_->gain[lane_] = static_cast<float>(velocity_ * volume_);
+    }
+}
+
+void Voice::control_tick(uint32_t n) {
+    if (!active_) {
+        return;
+    }
+    
+    // Glide to a new pitch over the chunk, then settle on it exactly
+    if (pitch_changed_) {
+        pitch_changed_ = false;
+        phase_increment_target_ = compute_phase_increment();
+        const int64_t distance = static_cast<int64_t>(phase_increment_target_)
+                               - static_cast<int64_t>(lanes_->phase_increment[lane_]);
+        lanes_->phase_increment_step[lane_] = static_cast<uint32_t>(distance / static_cast<int64_t>(n));
+    } else if (lanes_->phase_increment_step[lane_] != 0) {
+        lanes_->phase_increment[lane_] = phase_increment_target_;
+        lanes_->phase_increment_step[lane_] = 0;
+    }
+    
+    // The envelope is a straight ramp within the chunk, so its level at the
+    // end is exact
+    if (filter_changed_ || filter_env_amount_ != 0.0) {
+        filter_changed_ = false;
+        update_filter(lanes_->env_level[lane_] + lanes_->env_increment[lane_] * n, n);
+    } else if (lanes_->filter_a1_step[lane_] != 0.0f) {
+        lanes_->filter_a1_step[lane_] = 0.0f;
+        lanes_->filter_a2_step[lane_] = 0.0f;
+        lanes_->filter_a3_step[lane_] = 0.0f;
+    }
+}
+
+void Voice::advance(uint32_t n) {
     if (!active_) {
-        return 0.0;
+        return;
     }
     
     // Safety counter only for extreme cases (30 seconds)
-    safety_counter_++;
+    safety_counter_ += static_cast<int>(n);
     if (safety_counter_ > static_cast<int>(sample_rate_ * 30)) {
-        active_ = false;
-        env_state_ = ENV_IDLE;
-        env_level_ = 0.0;
-        return 0.0;
+        stop();
+        return;
     }
     
-    // Generate waveform
-    double sample = generate_waveform() * velocity_;
-    phase_ += phase_increment_;
-    if (phase_ >= 2.0 * M_PI) {
-        phase_ -= 2.0 * M_PI;
+    if (segment_remaining_ == NO_BOUNDARY) {
+        return;
     }
+    segment_remaining_ -= n;
+    if (segment_remaining_ == 0) {
+        finish_segment();
+    }
+}
+
+void Voice::finish_segment() {
+    // Snap to the exact target so rounding in the ramp never accumulates
+    lanes_->env_level[lane_] = segment_target_;
     
-    // Apply envelope
-    sample *= env_level_;
-    
-    // Update envelope
     switch (env_state_) {
         case ENV_ATTACK:
-            env_level_ += env_increment_;
-            if (env_level_ >= 1.0) {
-                env_level_ = 1.0;
-                env_state_ = ENV_DECAY;
-                update_envelope();
-            }
+            env_state_ = ENV_DECAY;
+            update_envelope();
             break;
             
         case ENV_DECAY:
-            env_level_ += env_increment_;
-            if (env_level_ <= sustain_level_) {
-                env_level_ = sustain_level_;
-                env_state_ = ENV_SUSTAIN;
-                env_increment_ = 0.0; // Stop changing in sustain
-            }
-            break;
-            
-        case ENV_SUSTAIN:
-            env_level_ = sustain_level_;
-            // Stay in sustain until note off
+            env_state_ = ENV_SUSTAIN;
+            update_envelope();
             break;
             
         case ENV_RELEASE:
-            env_level_ += env_increment_;
-            if (env_level_ <= 0.001) {
-                env_level_ = 0.0;
-                env_state_ = ENV_IDLE;
-                active_ = false;
-            }
+            stop();
             break;
             
+        case ENV_SUSTAIN:
         case ENV_IDLE:
-            active_ = false;
             break;
     }
-    
-    return sample;
 }
 
-void Voice::calculate_frequency() {
-    // Convert MIDI note to frequency: f = 440 * 2^((n-69)/12)
-    frequency_ = 440.0 * std::pow(2.0, (note_ - 69) / 12.0);
-    phase_increment_ = 2.0 * M_PI * frequency_ / sample_rate_;
+uint32_t Voice::compute_phase_increment() const {
+    // Plain notes come straight from the table, bent ones are interpolated
+    const double offset = pitch_bend_ + tuning_;
+    return (offset == 0.0)
+        ? notes_->phase_increment(note_)
+        : notes_->phase_increment(note_ + offset);
 }
 
 void Voice::update_envelope() {
+    double increment = 0.0;
+    double target = 0.0;
+    
     switch (env_state_) {
         case ENV_ATTACK:
             if (attack_time_ > 0.0) {
-                env_increment_ = 1.0 / (attack_time_ * sample_rate_);
+                increment = 1.0 / (attack_time_ * sample_rate_);
             } else {
-                env_increment_ = 1.0;
+                increment = 1.0;
             }
+            target = 1.0;
             break;
             
         case ENV_DECAY:
             if (decay_time_ > 0.0) {
-                env_increment_ = -(1.0 - sustain_level_) / (decay_time_ * sample_rate_);
+                increment = -(1.0 - sustain_level_) / (decay_time_ * sample_rate_);
             } else {
-                env_increment_ = -(1.0 - sustain_level_);
+                increment = -(1.0 - sustain_level_);
             }
+            target = sustain_level_;
             break;
             
-        case ENV_RELEASE:
+        case ENV_SUSTAIN:
+            lanes_->env_level[lane_] = static_cast<float>(sustain_level_);
+            target = sustain_level_;
+            break;
+            
+        case ENV_RELEASE: {
+            const double level = lanes_->env_level[lane_];
             if (release_time_ > 0.0) {
-                env_increment_ = -env_level_ / (release_time_ * sample_rate_);
+                increment = -level / (release_time_ * sample_rate_);
             } else {
-                env_increment_ = -env_level_;
+                increment = -level;
             }
             break;
+        }
             
-        default:
-            env_increment_ = 0.0;
+        case ENV_IDLE:
             break;
     }
+    
+    lanes_->env_increment[lane_] = static_cast<float>(increment);
+    segment_target_ = static_cast<float>(target);
+    
+    // Length of the ramp up to the target; sustain and idle hold forever
+    if (env_state_ == ENV_SUSTAIN || env_state_ == ENV_IDLE) {
+        segment_remaining_ = NO_BOUNDARY;
+        return;
+    }
+    const double distance = target - lanes_->env_level[lane_];
+    const double samples = (increment != 0.0) ? std::ceil(distance / increment) : 0.0;
+    if (samples < 1.0) {
+        segment_remaining_ = 0;
+        finish_segment();
+        return;
+    }
+    segment_remaining_ = static_cast<uint32_t>(std::min(samples, static_cast<double>(NO_BOUNDARY - 1)));
 }
 
-double Voice::generate_waveform() {
-    switch (waveform_) {
-        case 0: // Sine
-            return std::sin(phase_);
-            
-        case 1: // Square
-            return (phase_ < M_PI) ? 1.0 : -1.0;
-            
-        case 2: // Saw
-            return (2.0 * phase_ / (2.0 * M_PI)) - 1.0;
-            
-        case 3: // Triangle
-            if (phase_ < M_PI) {
-                return (2.0 * phase_ / M_PI) - 1.0;
-            } else {
-                return 3.0 - (2.0 * phase_ / M_PI);
-            }
-            
-        case 4: // Pulse (25% duty cycle)
-            return (phase_ < M_PI * 0.5) ? 1.0 : -1.0;
-            
-        default: // Default to sine
-            return std::sin(phase_);
+void Voice::update_filter(float env_level, uint32_t n) {
+    float* a1 = lanes_->filter_a1 + lane_;
+    float* a2 = lanes_->filter_a2 + lane_;
+    float* a3 = lanes_->filter_a3 + lane_;
+    float* a1_step = lanes_->filter_a1_step + lane_;
+    float* a2_step = lanes_->filter_a2_step + lane_;
+    float* a3_step = lanes_->filter_a3_step + lane_;
+    
+    // Fully open and unmodulated: skip the filter altogether
+    if (filter_cutoff_ >= MAX_CUTOFF && filter_env_amount_ == 0.0 && filter_key_track_ == 0.0) {
+        *a1 = *a2 = *a3 = 0.0f;
+        *a1_step = *a2_step = *a3_step = 0.0f;
+        return;
+    }
+    
+    const double octaves = filter_env_amount_ * env_level
+                         + filter_key_track_ * (note_ - 60) / 12.0;
+    const double cutoff = std::clamp(filter_cutoff_ * std::exp2(octaves), MIN_CUTOFF, 0.49 * sample_rate_);
+    
+    // Trapezoidal SVF (A. Simper): g is the prewarped integrator gain, k the
+    // damping. Full resonance stops short of self-oscillation (Q = 25).
+    const double g = std::tan(3.14159265358979323846 * cutoff / sample_rate_);
+    const double k = 2.0 - 1.96 * filter_resonance_;
+    const double c1 = 1.0 / (1.0 + g * (g + k));
+    const float target1 = static_cast<float>(c1);
+    const float target2 = static_cast<float>(g * c1);
+    const float target3 = static_cast<float>(g * g * c1);
+    
+    // A filter coming out of bypass starts on its coefficients, ramping from
+    // zero would mute it
+    if (n == 0 || *a1 == 0.0f) {
+        *a1 = target1;
+        *a2 = target2;
+        *a3 = target3;
+        *a1_step = *a2_step = *a3_step = 0.0f;
+        return;
     }
-}
\ No newline at end of file
+    const float scale = 1.0f / static_cast<float>(n);
+    *a1_step = (target1 - *a1) * scale;
+    *a2_step = (target2 - *a2) * scale;
+    *a3_step = (target3 - *a3) * scale;
+}
+
+void Voice::stop() {
+    active_ = false;
+    env_state_ = ENV_IDLE;
+    lanes_->phase[lane_] = 0;
+    lanes_->phase_increment[lane_] = 0;
+    lanes_->phase_increment_step[lane_] = 0;
+    lanes_->env_level[lane_] = 0.0f;
+    lanes_->env_increment[lane_] = 0.0f;
+    lanes_->gain[lane_] = 0.0f;
+    lanes_->waveform[lane_] = WAVE_SINE;
+    lanes_->filter_ic1[lane_] = 0.0f;
+    lanes_->filter_ic2[lane_] = 0.0f;
+    lanes_->filter_a1[lane_] = 0.0f;
+    lanes_->filter_a2[lane_] = 0.0f;
+    lanes_->filter_a3[lane_] = 0.0f;
+    lanes_->filter_a1_step[lane_] = 0.0f;
+    lanes_->filter_a2_step[lane_] = 0.0f;
+    lanes_->filter_a3_step[lane_] = 0.0f;
+}
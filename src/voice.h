@@ -1,20 +1,149 @@
 #pragma once
 
 #include <cmath>
+#include <cstdint>
+#include "note_table.h"
+
+enum Waveform {
+    WAVE_SINE = 0,
+    WAVE_SQUARE,
+    WAVE_SAW,
+    WAVE_TRIANGLE,
+    WAVE_PULSE,
+    WAVE_COUNT
+};
+
+// Audio-rate voice state stored as parallel arrays (one lane per voice) so
+// the render kernels can advance several voices per instruction. The arrays
+// live in storage owned by the VoiceBank, each one cache-line aligned and
+// padded to a whole number of vectors with silent lanes.
+struct VoiceLanes {
+    // Lane count is a multiple of the widest vector (16 floats)
+    static constexpr int LANE_ALIGN = 16;
+    static constexpr int ALIGNMENT = 64;
+    // Longest run the kernels render in one call
+    static constexpr uint32_t MAX_CHUNK = 32;
+    // Samples between control-rate updates (pitch, filter coefficients).
+    // The kernels ramp linearly from one update to the next.
+    static constexpr uint32_t CONTROL_INTERVAL = 32;
+    static_assert(CONTROL_INTERVAL <= MAX_CHUNK, "a control interval must fit one kernel call");
+
+    uint32_t* phase = nullptr;               // Fraction of a cycle in 1/2^32 units
+    uint32_t* phase_increment = nullptr;
+    uint32_t* phase_increment_step = nullptr; // Per-sample glide, two's complement
+    float* env_level = nullptr;
+    float* env_increment = nullptr;
+    float* gain = nullptr;                   // Velocity, zero for idle lanes
+    int32_t* waveform = nullptr;
+
+    // Zero-delay-feedback state variable filter (lowpass), see Voice::update_filter().
+    // All-zero coefficients bypass it.
+    float* filter_ic1 = nullptr;             // Integrator states
+    float* filter_ic2 = nullptr;
+    float* filter_a1 = nullptr;
+    float* filter_a2 = nullptr;
+    float* filter_a3 = nullptr;
+    float* filter_a1_step = nullptr;         // Per-sample coefficient ramps
+    float* filter_a2_step = nullptr;
+    float* filter_a3_step = nullptr;
+
+    // Number of per-lane arrays above
+    static constexpr int ARRAY_COUNT = 15;
+
+    // Lanes needed to hold voice_count voices
+    static constexpr int padded_count(int voice_count) {
+        return (voice_count + LANE_ALIGN - 1) / LANE_ALIGN * LANE_ALIGN;
+    }
+
+    // The lanes from first (a multiple of LANE_ALIGN) on
+    VoiceLanes subset(int first) const {
+        VoiceLanes lanes;
+        lanes.phase = phase + first;
+        lanes.phase_increment = phase_increment + first;
+        lanes.phase_increment_step = phase_increment_step + first;
+        lanes.env_level = env_level + first;
+        lanes.env_increment = env_increment + first;
+        lanes.gain = gain + first;
+        lanes.waveform = waveform + first;
+        lanes.filter_ic1 = filter_ic1 + first;
+        lanes.filter_ic2 = filter_ic2 + first;
+        lanes.filter_a1 = filter_a1 + first;
+        lanes.filter_a2 = filter_a2 + first;
+        lanes.filter_a3 = filter_a3 + first;
+        lanes.filter_a1_step = filter_a1_step + first;
+        lanes.filter_a2_step = filter_a2_step + first;
+        lanes.filter_a3_step = filter_a3_step + first;
+        return lanes;
+    }
+
+    void copy_lane(int from, int to) {
+        phase[to] = phase[from];
+        phase_increment[to] = phase_increment[from];
+        phase_increment_step[to] = phase_increment_step[from];
+        env_level[to] = env_level[from];
+        env_increment[to] = env_increment[from];
+        gain[to] = gain[from];
+        waveform[to] = waveform[from];
+        filter_ic1[to] = filter_ic1[from];
+        filter_ic2[to] = filter_ic2[from];
+        filter_a1[to] = filter_a1[from];
+        filter_a2[to] = filter_a2[from];
+        filter_a3[to] = filter_a3[from];
+        filter_a1_step[to] = filter_a1_step[from];
+        filter_a2_step[to] = filter_a2_step[from];
+        filter_a3_step[to] = filter_a3_step[from];
+    }
+};
 
 class Voice {
 public:
     Voice();
     ~Voice() = default;
 
-    void note_on(int note, double velocity, double sample_rate);
+    void bind(VoiceLanes* lanes, int lane);
+    // Move this voice's audio-rate state to another lane of the same bank
+    void relocate(int lane);
+
+    void note_on(int note, double velocity, const NoteTable& notes);
     void note_off();
     void set_adsr(double attack, double decay, double sustain, double release);
     void set_waveform(int waveform);
+    void set_filter(double cutoff, double resonance, double env_amount, double key_track);
+    // Pitch and filter changes take effect at the next control_tick()
+    void set_pitch_bend(double semitones);
+    // Per-note expressions, reset by note_on()
+    void set_tuning(double semitones);
+    void set_volume(double gain);
     bool is_active() const { return active_; }
+    bool is_released() const { return env_state_ == ENV_RELEASE; }
     int get_note() const { return note_; }
-    
-    double process();
+
+    // Output level the current envelope segment ends at, including velocity
+    float target_level() const { return segment_target_ * lanes_->gain[lane_]; }
+
+    // Ramp a stolen voice to silence. The voice keeps sounding on its own
+    // lane and stops by itself; is_fading() stays set until the next start.
+    void fade_out(double seconds);
+    bool is_fading() const { return fading_; }
+
+    static constexpr uint32_t NO_BOUNDARY = UINT32_MAX;
+
+    // Samples until the current envelope segment ends. The bank never
+    // renders past this, so stage changes land on the exact sample.
+    uint32_t segment_remaining() const { return active_ ? segment_remaining_ : NO_BOUNDARY; }
+
+    // Account for n <= segment_remaining() rendered samples and move to the
+    // next envelope stage at a segment boundary
+    void advance(uint32_t n);
+
+    static constexpr double MIN_CUTOFF = 20.0;
+    static constexpr double MAX_CUTOFF = 20000.0;
+
+    // Control-rate update before rendering the next n samples: recompute
+    // what changed or is modulated and set the lanes ramping to the values
+    // due after those n samples. The bank calls this at the start of every
+    // chunk, so at least every CONTROL_INTERVAL samples.
+    void control_tick(uint32_t n);
 
 private:
     enum EnvelopeState {
@@ -25,32 +154,51 @@ private:
         ENV_RELEASE
     };
 
+    VoiceLanes* lanes_;
+    int lane_;
+
+    const NoteTable* notes_;
+
     bool active_;
     int note_;
     double velocity_;
-    double frequency_;
+    double pitch_bend_;
+    double tuning_;
+    double volume_;
     double sample_rate_;
-    
-    // Oscillator
-    double phase_;
-    double phase_increment_;
-    
+
     // Envelope
     EnvelopeState env_state_;
-    double env_level_;
     double attack_time_;
     double decay_time_;
     double sustain_level_;
     double release_time_;
-    double env_increment_;
-    
+    uint32_t segment_remaining_;
+    float segment_target_;
+
     // Safety counter to prevent hanging notes
     int safety_counter_;
-    
+
     // Waveform
     int waveform_;
-    
-    void calculate_frequency();
+
+    // Filter
+    double filter_cutoff_;
+    double filter_resonance_;
+    double filter_env_amount_;      // Octaves at full envelope level
+    double filter_key_track_;       // 1 follows the keyboard exactly, around middle C
+
+    // Control-rate state
+    bool pitch_changed_;
+    bool filter_changed_;
+    uint32_t phase_increment_target_;
+
+    bool fading_;
+
+    uint32_t compute_phase_increment() const;
     void update_envelope();
-    double generate_waveform();
-};
\ No newline at end of file
+    // Coefficients for an envelope level, reached after n samples (0 sets them now)
+    void update_filter(float env_level, uint32_t n);
+    void finish_segment();
+    void stop();
+};
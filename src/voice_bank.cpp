@@ -0,0 +1,324 @@
+#include "voice_bank.h"
+#include "dsp_dispatch.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace {
+
+size_t round_up(size_t bytes) {
+    return (bytes + VoiceLanes::ALIGNMENT - 1) / VoiceLanes::ALIGNMENT * VoiceLanes::ALIGNMENT;
+}
+
+} // namespace
+
+VoiceBank::VoiceBank()
+    : storage_(nullptr)
+    , voices_(nullptr)
+    , capacity_(0)
+    , slot_count_(0)
+    , active_count_(0)
+    , fade_count_(0)
+    , steal_policy_(STEAL_RELEASED_FIRST)
+    , clock_(0)
+    , note_count_(0)
+    , max_frames_(0)
+    , task_buffers_(nullptr)
+    , task_stride_(0)
+    , render_out_(nullptr)
+    , render_frames_(0)
+    , render_voices_(0)
+    , task_count_(0)
+{
+    for (int slot = 0; slot < MAX_SLOTS; ++slot) {
+        start_order_[slot] = 0;
+        stage_changed_[slot] = false;
+    }
+}
+
+VoiceBank::~VoiceBank() {
+    release_storage();
+}
+
+void VoiceBank::set_capacity(int voice_count, uint32_t max_frames) {
+    voice_count = std::clamp(voice_count, MIN_VOICES, MAX_VOICES);
+    active_count_ = 0;
+    fade_count_ = 0;
+    index_.clear();
+    queue_.clear();
+    clock_ = 0;
+    note_count_ = 0;
+
+    if (voice_count != capacity_ || max_frames != max_frames_) {
+        release_storage();
+
+        // The lane arrays, the voices, then one output buffer per render
+        // task. Every array is a whole number of cache lines, so each one
+        // starts on a line boundary.
+        const int slot_count = voice_count + MAX_FADES;
+        const int task_count = (VoiceLanes::padded_count(slot_count) + TASK_LANES - 1) / TASK_LANES;
+        const size_t lane_bytes = VoiceLanes::padded_count(slot_count) * sizeof(float);
+        const size_t voices_offset = VoiceLanes::ARRAY_COUNT * lane_bytes;
+        const size_t buffers_offset = round_up(voices_offset + slot_count * sizeof(Voice));
+        const size_t buffer_stride = VoiceLanes::padded_count(static_cast<int>(max_frames));
+        const size_t total = buffers_offset + task_count * buffer_stride * sizeof(float);
+        static_assert(VoiceLanes::LANE_ALIGN * sizeof(float) % VoiceLanes::ALIGNMENT == 0,
+                      "lane arrays must stay cache-line aligned");
+
+        storage_ = ::operator new(total, std::align_val_t(VoiceLanes::ALIGNMENT));
+        char* bytes = static_cast<char*>(storage_);
+        std::memset(bytes, 0, voices_offset);
+        lanes_.phase = reinterpret_cast<uint32_t*>(bytes);
+        lanes_.phase_increment = reinterpret_cast<uint32_t*>(bytes + lane_bytes);
+        lanes_.phase_increment_step = reinterpret_cast<uint32_t*>(bytes + 2 * lane_bytes);
+        lanes_.env_level = reinterpret_cast<float*>(bytes + 3 * lane_bytes);
+        lanes_.env_increment = reinterpret_cast<float*>(bytes + 4 * lane_bytes);
+        lanes_.gain = reinterpret_cast<float*>(bytes + 5 * lane_bytes);
+        lanes_.waveform = reinterpret_cast<int32_t*>(bytes + 6 * lane_bytes);
+        lanes_.filter_ic1 = reinterpret_cast<float*>(bytes + 7 * lane_bytes);
+        lanes_.filter_ic2 = reinterpret_cast<float*>(bytes + 8 * lane_bytes);
+        lanes_.filter_a1 = reinterpret_cast<float*>(bytes + 9 * lane_bytes);
+        lanes_.filter_a2 = reinterpret_cast<float*>(bytes + 10 * lane_bytes);
+        lanes_.filter_a3 = reinterpret_cast<float*>(bytes + 11 * lane_bytes);
+        lanes_.filter_a1_step = reinterpret_cast<float*>(bytes + 12 * lane_bytes);
+        lanes_.filter_a2_step = reinterpret_cast<float*>(bytes + 13 * lane_bytes);
+        lanes_.filter_a3_step = reinterpret_cast<float*>(bytes + 14 * lane_bytes);
+
+        voices_ = reinterpret_cast<Voice*>(bytes + voices_offset);
+        for (int i = 0; i < slot_count; ++i) {
+            new (&voices_[i]) Voice();
+        }
+        task_buffers_ = reinterpret_cast<float*>(bytes + buffers_offset);
+        task_stride_ = buffer_stride;
+        max_frames_ = max_frames;
+        capacity_ = voice_count;
+        slot_count_ = slot_count;
+    }
+
+    for (int i = 0; i < slot_count_; ++i) {
+        voices_[i].bind(&lanes_, i);
+    }
+}
+
+void VoiceBank::release_storage() {
+    if (!storage_) {
+        return;
+    }
+    for (int i = 0; i < slot_count_; ++i) {
+        voices_[i].~Voice();
+    }
+    ::operator delete(storage_, std::align_val_t(VoiceLanes::ALIGNMENT));
+    storage_ = nullptr;
+    lanes_ = VoiceLanes();
+    voices_ = nullptr;
+    task_buffers_ = nullptr;
+    max_frames_ = 0;
+    capacity_ = 0;
+    slot_count_ = 0;
+    active_count_ = 0;
+    fade_count_ = 0;
+}
+
+Voice* VoiceBank::allocate() {
+    if (active_count_ - fade_count_ == capacity_) {
+        return nullptr;
+    }
+    return &voices_[active_count_++];
+}
+
+Voice* VoiceBank::steal(const NoteKey& key) {
+    if (queue_.empty()) {
+        return nullptr;
+    }
+
+    int victim = -1;
+    if (steal_policy_ == STEAL_SAME_NOTE) {
+        NoteKey pattern = key;
+        pattern.note_id = -1;
+        index_.for_each_match(pattern, active_count_, [&](int slot) {
+            if (victim < 0) {
+                victim = slot;
+            }
+        });
+    }
+    if (victim < 0) {
+        victim = queue_.top();
+    }
+
+    // Let the old note fade on a spare slot instead of cutting it off. With
+    // every spare slot busy it is cut, as before.
+    Voice& voice = voices_[victim];
+    if (voice.is_active() && fade_count_ < MAX_FADES) {
+        const int spare = active_count_++;
+        voices_[spare] = voice;
+        voices_[spare].relocate(spare);
+        voices_[spare].fade_out(STEAL_FADE_SECONDS);
+        ++fade_count_;
+    }
+    return &voice;
+}
+
+void VoiceBank::set_steal_policy(StealPolicy policy) {
+    if (policy == steal_policy_) {
+        return;
+    }
+    steal_policy_ = policy;
+
+    // Every key depends on the policy
+    for (int slot = 0; slot < active_count_; ++slot) {
+        if (!voices_[slot].is_fading()) {
+            queue_.update(slot, steal_key(slot));
+        }
+    }
+}
+
+void VoiceBank::assign_note(Voice* voice, const NoteKey& key) {
+    const int slot = static_cast<int>(voice - voices_);
+    index_.insert(slot, key);
+    start_order_[slot] = ++note_count_;
+    queue_.update(slot, steal_key(slot));
+}
+
+StealKey VoiceBank::steal_key(int slot) const {
+    // Smallest key is stolen first. Keys are only refreshed when a voice
+    // starts, is released or changes envelope stage, so they are built from
+    // values that hold for a whole segment: start order, the time the
+    // release ends and the level the segment heads for.
+    const Voice& voice = voices_[slot];
+    const uint64_t age = start_order_[slot];
+    const uint64_t release_end = clock_ + voice.segment_remaining();
+
+    switch (steal_policy_) {
+        case STEAL_OLDEST:
+            return StealKey{0, age};
+
+        case STEAL_QUIETEST: {
+            // Non-negative floats order like their bit patterns. Ties (a
+            // release and a decay to zero sustain both head for zero) go to
+            // released notes first, by earliest end, then to held notes,
+            // oldest first; the two clocks are never compared.
+            const float level = voice.target_level();
+            uint32_t bits;
+            std::memcpy(&bits, &level, sizeof(bits));
+            return StealKey{bits, voice.is_released() ? release_end : (1ull << 63) | age};
+        }
+
+        case STEAL_RELEASED_FIRST:
+        case STEAL_SAME_NOTE:
+        default:
+            return voice.is_released() ? StealKey{0, release_end} : StealKey{1, age};
+    }
+}
+
+int VoiceBank::begin_render(float* out, uint32_t n) {
+    // Voices released with a zero-length release stop outside of rendering
+    remove_finished();
+
+    render_out_ = out;
+    render_frames_ = n;
+    render_voices_ = active_count_;
+    if (active_count_ == 0 || n == 0) {
+        task_count_ = 0;
+    } else if (active_count_ <= TASK_LANES || n > max_frames_) {
+        // Not worth splitting; the single task renders straight into out
+        task_count_ = 1;
+    } else {
+        task_count_ = (active_count_ + TASK_LANES - 1) / TASK_LANES;
+    }
+    return task_count_;
+}
+
+void VoiceBank::render_task(int task) {
+    const int first = task_count_ == 1 ? 0 : task * TASK_LANES;
+    const int last = task_count_ == 1 ? render_voices_ : std::min(render_voices_, first + TASK_LANES);
+    VoiceLanes lanes = lanes_.subset(first);
+    const int lane_count = VoiceLanes::padded_count(last - first);
+
+    float* out = render_out_;
+    if (task_count_ > 1) {
+        out = task_buffers_ + task * task_stride_;
+        std::memset(out, 0, render_frames_ * sizeof(float));
+    }
+
+    const DspKernels& kernels = dsp_kernels();
+    uint64_t clock = clock_;
+    uint32_t n = render_frames_;
+    while (n > 0) {
+        // Render up to the next control tick, which sit on a fixed grid
+        // whatever the block size, or the nearest envelope segment boundary
+        // so every ramp inside the chunk is a plain linear segment
+        const uint32_t to_tick = VoiceLanes::CONTROL_INTERVAL
+                               - static_cast<uint32_t>(clock % VoiceLanes::CONTROL_INTERVAL);
+        uint32_t chunk = std::min(n, to_tick);
+        for (int slot = first; slot < last; ++slot) {
+            chunk = std::min(chunk, voices_[slot].segment_remaining());
+        }
+        for (int slot = first; slot < last; ++slot) {
+            voices_[slot].control_tick(chunk);
+        }
+
+        kernels.render_voices(lanes, lane_count, out, chunk);
+        for (int slot = first; slot < last; ++slot) {
+            Voice& voice = voices_[slot];
+            // A new envelope stage changes the steal key
+            stage_changed_[slot] |= voice.segment_remaining() == chunk;
+            voice.advance(chunk);
+        }
+
+        out += chunk;
+        clock += chunk;
+        n -= chunk;
+    }
+}
+
+void VoiceBank::end_render() {
+    if (task_count_ > 1) {
+        for (int task = 0; task < task_count_; ++task) {
+            const float* buffer = task_buffers_ + task * task_stride_;
+            for (uint32_t i = 0; i < render_frames_; ++i) {
+                render_out_[i] += buffer[i];
+            }
+        }
+    }
+
+    clock_ += render_frames_;
+    for (int slot = 0; slot < render_voices_; ++slot) {
+        if (!stage_changed_[slot]) {
+            continue;
+        }
+        stage_changed_[slot] = false;
+        const Voice& voice = voices_[slot];
+        if (voice.is_active() && !voice.is_fading()) {
+            queue_.update(slot, steal_key(slot));
+        }
+    }
+    remove_finished();
+    task_count_ = 0;
+}
+
+void VoiceBank::remove_finished() {
+    int i = 0;
+    while (i < active_count_) {
+        if (voices_[i].is_active()) {
+            ++i;
+            continue;
+        }
+
+        if (voices_[i].is_fading()) {
+            --fade_count_;
+        }
+
+        // Fill the hole with the last active voice and clear its old lane
+        const int last = --active_count_;
+        index_.remove(i);
+        queue_.remove(i);
+        if (i != last) {
+            voices_[i] = voices_[last];
+            voices_[i].relocate(i);
+            index_.move(last, i);
+            queue_.move(last, i);
+            start_order_[i] = start_order_[last];
+        }
+        voices_[last].bind(&lanes_, last);
+    }
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include "note_index.h"
+#include "voice.h"
+#include "voice_stealing.h"
+
+// Owns every voice of the synth. Per-voice control state lives in the Voice
+// objects, the audio-rate state in one set of aligned parallel arrays that
+// the SIMD kernels render in a single pass. Both come out of one contiguous
+// block sized by set_capacity(), so nothing is allocated while processing.
+//
+// Sounding voices are kept packed at the front of the bank, so rendering,
+// allocation and note lookups only ever touch the active ones: a new voice
+// is taken from just past the active range, and a voice that finishes is
+// replaced by the last active one. A NoteIndex follows the voices around so
+// note-offs and note expressions reach them without a scan, and a
+// StealQueue keeps the next victim for a full bank at hand.
+//
+// A block is rendered as independent tasks over groups of TASK_LANES lanes,
+// so a thread pool can spread large voice counts over several cores:
+//
+//     const int tasks = bank.begin_render(out, n);
+//     for (int i = 0; i < tasks; ++i) bank.render_task(i);  // any thread
+//     bank.end_render();
+//
+// Each task only touches its own voices and lanes and renders into a private
+// buffer; end_render() sums the buffers into out on the calling thread and
+// does all the shared bookkeeping.
+class VoiceBank {
+public:
+    static constexpr int MIN_VOICES = 4;
+    static constexpr int MAX_VOICES = 256;
+    static constexpr int DEFAULT_VOICES = 16;
+    // Spare slots where stolen notes fade out next to the new ones
+    static constexpr int MAX_FADES = 16;
+    static constexpr double STEAL_FADE_SECONDS = 0.005;
+    // Lanes per render task; fewer active voices than this render in one task
+    static constexpr int TASK_LANES = 32;
+
+    VoiceBank();
+    ~VoiceBank();
+    VoiceBank(const VoiceBank&) = delete;
+    VoiceBank& operator=(const VoiceBank&) = delete;
+
+    // Size the pool for voice_count voices (clamped to MIN_VOICES..MAX_VOICES)
+    // and blocks of up to max_frames, and stop every voice. Allocates, so
+    // only call it from activate().
+    void set_capacity(int voice_count, uint32_t max_frames);
+    int capacity() const { return capacity_; }
+    // Most tasks begin_render() can return
+    int max_tasks() const { return (VoiceLanes::padded_count(slot_count_) + TASK_LANES - 1) / TASK_LANES; }
+
+    // Iterate over the active voices only
+    Voice* begin() { return voices_; }
+    Voice* end() { return voices_ + active_count_; }
+    Voice& operator[](int index) { return voices_[index]; }
+    int size() const { return active_count_; }
+
+    // True when no voice is sounding
+    bool is_idle() const { return active_count_ == 0; }
+
+    // Take a free voice, or nullptr if all are sounding. The caller starts
+    // it with note_on() right away.
+    Voice* allocate();
+
+    // Take a voice from a full bank for key, chosen by the steal policy.
+    // The old note is handed to a spare slot and faded out there, so the new
+    // note can start at once. Returns nullptr only if nothing is playing.
+    Voice* steal(const NoteKey& key);
+
+    void set_steal_policy(StealPolicy policy);
+    StealPolicy steal_policy() const { return steal_policy_; }
+
+    // Record which note a freshly started or stolen voice plays. Call it
+    // after note_on().
+    void assign_note(Voice* voice, const NoteKey& key);
+
+    // Call f(voice) for every active voice playing a note matching pattern
+    template <class F>
+    void for_each_note(const NoteKey& pattern, F f) {
+        index_.for_each_match(pattern, active_count_, [&](int slot) {
+            f(voices_[slot]);
+            // f may have released the voice
+            queue_.update(slot, steal_key(slot));
+        });
+    }
+
+    // Render all voices and accumulate them into out, see above. Returns the
+    // number of tasks, 0 when nothing is playing.
+    int begin_render(float* out, uint32_t n);
+    void render_task(int task);
+    void end_render();
+
+private:
+    static constexpr int MAX_SLOTS = MAX_VOICES + MAX_FADES;
+    static constexpr int MAX_TASKS = (VoiceLanes::padded_count(MAX_SLOTS) + TASK_LANES - 1) / TASK_LANES;
+    static_assert(TASK_LANES % VoiceLanes::LANE_ALIGN == 0, "tasks must start on a whole vector");
+    static_assert(MAX_SLOTS <= NoteIndex::MAX_SLOTS && MAX_SLOTS <= StealQueue::MAX_SLOTS,
+                  "voice slots exceed the lookup tables");
+
+    void* storage_;
+    VoiceLanes lanes_;
+    Voice* voices_;
+    int capacity_;
+    int slot_count_;        // capacity_ plus the fade slots
+    int active_count_;      // Active slots, fading ones included
+    int fade_count_;
+    NoteIndex index_;
+
+    // Voice stealing
+    StealPolicy steal_policy_;
+    StealQueue queue_;
+    uint64_t clock_;                    // Samples rendered since activation
+    uint64_t note_count_;
+    uint64_t start_order_[MAX_SLOTS];   // note_count_ when the slot's note started
+
+    // Block being rendered
+    uint32_t max_frames_;
+    float* task_buffers_;           // MAX_TASKS buffers of max_frames_, padded
+    size_t task_stride_;
+    float* render_out_;
+    uint32_t render_frames_;
+    int render_voices_;
+    int task_count_;
+    bool stage_changed_[MAX_SLOTS]; // Set by tasks, read by end_render()
+
+    StealKey steal_key(int slot) const;
+    void release_storage();
+    void remove_finished();
+};
@@ -0,0 +1,382 @@
+#pragma once
+
+#include <cstdint>
+#include "fast_sine.h"
+#include "simd.h"
+#include "voice.h"
+
+// Voice render and mix kernels, written once against the Simd* wrappers and
+// instantiated per instruction set by the voice_kernels_*.cpp translation
+// units. Each voice kernel advances S::width voices per instruction; lanes
+// are grouped in runs of S::width.
+
+namespace voice_kernels {
+
+// Per-lane phase increment and its reciprocal, constant over a chunk
+template <class S>
+struct PhaseStep {
+    typename S::V dt;
+    typename S::V inv_dt;
+};
+
+// Offsets into the 32-bit phase cycle; the adds wrap on their own
+constexpr uint32_t PHASE_HALF = 0x80000000u;
+constexpr uint32_t PHASE_THREE_QUARTERS = 0xC0000000u;
+
+// Two-sample polynomial residual of a band-limited step of height 2 at
+// phase 0 (PolyBLEP). Subtracting it from a naive falling edge, or adding it
+// to a rising one, removes most of the aliasing.
+template <class S>
+typename S::V poly_blep(typename S::V t, const PhaseStep<S>& step) {
+    using V = typename S::V;
+    const V one = S::set1(1.0f);
+
+    // Just after the discontinuity: 2x - x^2 - 1 with x = t / dt
+    const V x0 = S::mul(t, step.inv_dt);
+    const V after = S::sub(S::sub(S::add(x0, x0), S::mul(x0, x0)), one);
+
+    // Just before it: x^2 + 2x + 1 with x = (t - 1) / dt
+    const V x1 = S::mul(S::sub(t, one), step.inv_dt);
+    const V before = S::add(S::add(S::mul(x1, x1), S::add(x1, x1)), one);
+
+    return S::select(S::cmp_lt(t, step.dt), after,
+                     S::select(S::cmp_lt(S::sub(one, step.dt), t), before, S::zero()));
+}
+
+// Two-sample polynomial residual of a band-limited unit corner at phase 0
+// (PolyBLAMP), scaled by the per-sample change in slope by the caller
+template <class S>
+typename S::V poly_blamp(typename S::V t, const PhaseStep<S>& step) {
+    using V = typename S::V;
+    const V one = S::set1(1.0f);
+    const V third = S::set1(1.0f / 3.0f);
+
+    // Just after the corner: -x^3 / 3 with x = t / dt - 1
+    const V x0 = S::sub(S::mul(t, step.inv_dt), one);
+    const V after = S::mul(S::mul(S::mul(x0, x0), x0), S::set1(-1.0f / 3.0f));
+
+    // Just before it: x^3 / 3 with x = (t - 1) / dt + 1
+    const V x1 = S::add(S::mul(S::sub(t, one), step.inv_dt), one);
+    const V before = S::mul(S::mul(S::mul(x1, x1), x1), third);
+
+    return S::select(S::cmp_lt(t, step.dt), after,
+                     S::select(S::cmp_lt(S::sub(one, step.dt), t), before, S::zero()));
+}
+
+template <class S>
+struct Sine {
+    typename S::V operator()(typename S::VI phase, const PhaseStep<S>&) const {
+        return fast_sine<S>(S::phase_to_unit(phase));
+    }
+};
+
+// Band-limited shapes used by the voices
+
+template <class S>
+struct Square {
+    typename S::V operator()(typename S::VI phase, const PhaseStep<S>& step) const {
+        const typename S::V t = S::phase_to_unit(phase);
+        const typename S::V naive =
+            S::select(S::cmp_lt(t, S::set1(0.5f)), S::set1(1.0f), S::set1(-1.0f));
+        const typename S::V falling = S::phase_to_unit(S::addi(phase, S::set1i(PHASE_HALF)));
+        return S::sub(S::add(naive, poly_blep<S>(t, step)), poly_blep<S>(falling, step));
+    }
+};
+
+template <class S>
+struct Saw {
+    typename S::V operator()(typename S::VI phase, const PhaseStep<S>& step) const {
+        const typename S::V t = S::phase_to_unit(phase);
+        const typename S::V naive = S::sub(S::add(t, t), S::set1(1.0f));
+        return S::sub(naive, poly_blep<S>(t, step));
+    }
+};
+
+template <class S>
+struct Triangle {
+    typename S::V operator()(typename S::VI phase, const PhaseStep<S>& step) const {
+        const typename S::V t = S::phase_to_unit(phase);
+        const typename S::V p4 = S::mul(t, S::set1(4.0f));
+        const typename S::V naive = S::select(S::cmp_lt(t, S::set1(0.5f)),
+                                              S::sub(p4, S::set1(1.0f)),
+                                              S::sub(S::set1(3.0f), p4));
+        // The slope flips between +4 and -4 per cycle, a change of 8 * dt
+        // per sample at each corner
+        const typename S::V peak = S::phase_to_unit(S::addi(phase, S::set1i(PHASE_HALF)));
+        const typename S::V corners = S::sub(poly_blamp<S>(t, step), poly_blamp<S>(peak, step));
+        return S::add(naive, S::mul(S::mul(S::set1(8.0f), step.dt), corners));
+    }
+};
+
+template <class S>
+struct Pulse {
+    typename S::V operator()(typename S::VI phase, const PhaseStep<S>& step) const {
+        const typename S::V t = S::phase_to_unit(phase);
+        const typename S::V naive =
+            S::select(S::cmp_lt(t, S::set1(0.25f)), S::set1(1.0f), S::set1(-1.0f));
+        const typename S::V falling = S::phase_to_unit(S::addi(phase, S::set1i(PHASE_THREE_QUARTERS)));
+        return S::sub(S::add(naive, poly_blep<S>(t, step)), poly_blep<S>(falling, step));
+    }
+};
+
+// Naive (aliasing) shapes, kept as the reference for bench_oscillators.cpp
+
+template <class S>
+struct NaiveSquare {
+    typename S::V operator()(typename S::VI phase, const PhaseStep<S>&) const {
+        const typename S::V t = S::phase_to_unit(phase);
+        return S::select(S::cmp_lt(t, S::set1(0.5f)), S::set1(1.0f), S::set1(-1.0f));
+    }
+};
+
+template <class S>
+struct NaiveSaw {
+    typename S::V operator()(typename S::VI phase, const PhaseStep<S>&) const {
+        const typename S::V t = S::phase_to_unit(phase);
+        return S::sub(S::add(t, t), S::set1(1.0f));
+    }
+};
+
+template <class S>
+struct NaiveTriangle {
+    typename S::V operator()(typename S::VI phase, const PhaseStep<S>&) const {
+        const typename S::V t = S::phase_to_unit(phase);
+        const typename S::V p4 = S::mul(t, S::set1(4.0f));
+        return S::select(S::cmp_lt(t, S::set1(0.5f)),
+                         S::sub(p4, S::set1(1.0f)),
+                         S::sub(S::set1(3.0f), p4));
+    }
+};
+
+template <class S>
+struct NaivePulse {
+    typename S::V operator()(typename S::VI phase, const PhaseStep<S>&) const {
+        const typename S::V t = S::phase_to_unit(phase);
+        return S::select(S::cmp_lt(t, S::set1(0.25f)), S::set1(1.0f), S::set1(-1.0f));
+    }
+};
+
+// Groups holding voices with different waveforms evaluate every waveform
+// present and weight each by a per-lane 0/1 mask
+template <class S>
+struct Mixed {
+    uint32_t present;
+    typename S::V weight[WAVE_COUNT];
+
+    typename S::V operator()(typename S::VI phase, const PhaseStep<S>& step) const {
+        typename S::V sample = S::zero();
+        if (present & (1u << WAVE_SINE))
+            sample = S::add(sample, S::mul(weight[WAVE_SINE], Sine<S>()(phase, step)));
+        if (present & (1u << WAVE_SQUARE))
+            sample = S::add(sample, S::mul(weight[WAVE_SQUARE], Square<S>()(phase, step)));
+        if (present & (1u << WAVE_SAW))
+            sample = S::add(sample, S::mul(weight[WAVE_SAW], Saw<S>()(phase, step)));
+        if (present & (1u << WAVE_TRIANGLE))
+            sample = S::add(sample, S::mul(weight[WAVE_TRIANGLE], Triangle<S>()(phase, step)));
+        if (present & (1u << WAVE_PULSE))
+            sample = S::add(sample, S::mul(weight[WAVE_PULSE], Pulse<S>()(phase, step)));
+        return sample;
+    }
+};
+
+// Render one group of S::width lanes starting at lane g into acc, which
+// holds n interleaved vectors of partial sums. The caller keeps n inside
+// every lane's envelope segment, so the envelope is a plain ramp; groups
+// that are all holding a level and pitch (Ramp = false) only pay one
+// multiply. Filter runs the oscillator through each lane's lowpass SVF,
+// with its coefficients ramping towards the next control tick.
+template <class S, bool Ramp, bool Filter, class Osc>
+void render_group(VoiceLanes& lanes, int g, float* acc, uint32_t n, const Osc& osc) {
+    using V = typename S::V;
+    using VI = typename S::VI;
+
+    VI phase = S::loadi(lanes.phase + g);
+    VI phase_increment = S::loadi(lanes.phase_increment + g);
+    const VI phase_increment_step = S::loadi(lanes.phase_increment_step + g);
+    V level = S::load(lanes.env_level + g);
+    const V env_increment = S::load(lanes.env_increment + g);
+    const V gain = S::load(lanes.gain + g);
+    const V amplitude = S::mul(gain, level);
+
+    V ic1 = S::zero();
+    V ic2 = S::zero();
+    V a1 = S::zero();
+    V a2 = S::zero();
+    V a3 = S::zero();
+    V a1_step = S::zero();
+    V a2_step = S::zero();
+    V a3_step = S::zero();
+    if (Filter) {
+        ic1 = S::load(lanes.filter_ic1 + g);
+        ic2 = S::load(lanes.filter_ic2 + g);
+        a1 = S::load(lanes.filter_a1 + g);
+        a2 = S::load(lanes.filter_a2 + g);
+        a3 = S::load(lanes.filter_a3 + g);
+        a1_step = S::load(lanes.filter_a1_step + g);
+        a2_step = S::load(lanes.filter_a2_step + g);
+        a3_step = S::load(lanes.filter_a3_step + g);
+    }
+
+    // Increments stay below 2^31 (Nyquist), so the signed conversion is
+    // exact enough. Idle lanes have a zero increment, keep its reciprocal
+    // finite. A glide changes the increment by a fraction of a percent per
+    // chunk, so the PolyBLEP width keeps the starting value.
+    PhaseStep<S> step;
+    step.dt = S::mul(S::to_float(phase_increment), S::set1(1.0f / 4294967296.0f));
+    step.inv_dt = S::div(S::set1(1.0f), S::max(step.dt, S::set1(1e-9f)));
+
+    for (uint32_t i = 0; i < n; ++i) {
+        V x = osc(phase, step);
+        if (Filter) {
+            // Trapezoidal SVF, lowpass output v2
+            const V v3 = S::sub(x, ic2);
+            const V v1 = S::add(S::mul(a1, ic1), S::mul(a2, v3));
+            const V v2 = S::add(S::add(ic2, S::mul(a2, ic1)), S::mul(a3, v3));
+            ic1 = S::sub(S::add(v1, v1), ic1);
+            ic2 = S::sub(S::add(v2, v2), ic2);
+            x = v2;
+            a1 = S::add(a1, a1_step);
+            a2 = S::add(a2, a2_step);
+            a3 = S::add(a3, a3_step);
+        }
+
+        V sample;
+        if (Ramp) {
+            sample = S::mul(S::mul(x, gain), level);
+            level = S::add(level, env_increment);
+        } else {
+            sample = S::mul(x, amplitude);
+        }
+        S::store(acc + i * S::width, S::add(S::load(acc + i * S::width), sample));
+
+        // Wraps at 2^32 without a compare
+        phase = S::addi(phase, phase_increment);
+        if (Ramp) {
+            phase_increment = S::addi(phase_increment, phase_increment_step);
+        }
+    }
+
+    S::storei(lanes.phase + g, phase);
+    if (Ramp) {
+        S::storei(lanes.phase_increment + g, phase_increment);
+        S::store(lanes.env_level + g, level);
+    }
+    if (Filter) {
+        S::store(lanes.filter_ic1 + g, ic1);
+        S::store(lanes.filter_ic2 + g, ic2);
+        S::store(lanes.filter_a1 + g, a1);
+        S::store(lanes.filter_a2 + g, a2);
+        S::store(lanes.filter_a3 + g, a3);
+    }
+}
+
+template <class S, class Osc>
+void render_group(VoiceLanes& lanes, int g, float* acc, uint32_t n, const Osc& osc,
+                  bool ramp, bool filter) {
+    if (filter) {
+        if (ramp) {
+            render_group<S, true, true>(lanes, g, acc, n, osc);
+        } else {
+            render_group<S, false, true>(lanes, g, acc, n, osc);
+        }
+    } else if (ramp) {
+        render_group<S, true, false>(lanes, g, acc, n, osc);
+    } else {
+        render_group<S, false, false>(lanes, g, acc, n, osc);
+    }
+}
+
+// Render lane_count lanes (a multiple of S::width) for n <= MAX_CHUNK frames
+// and accumulate the sum of all voices into out
+template <class S>
+void render_lanes(VoiceLanes& lanes, int lane_count, float* out, uint32_t n) {
+    alignas(64) float acc[VoiceLanes::MAX_CHUNK * S::width];
+    for (uint32_t i = 0; i < n * S::width; ++i) {
+        acc[i] = 0.0f;
+    }
+
+    bool any = false;
+    for (int g = 0; g < lane_count; g += S::width) {
+        uint32_t present = 0;
+        bool ramp = false;
+        bool filter = false;
+        for (int lane = g; lane < g + S::width; ++lane) {
+            if (lanes.gain[lane] != 0.0f) {
+                present |= 1u << lanes.waveform[lane];
+                ramp |= lanes.env_increment[lane] != 0.0f || lanes.phase_increment_step[lane] != 0;
+                filter |= lanes.filter_a1[lane] != 0.0f;
+            }
+        }
+        if (present == 0) {
+            continue;
+        }
+        any = true;
+
+        switch (present) {
+            case 1u << WAVE_SINE:     render_group<S>(lanes, g, acc, n, Sine<S>(), ramp, filter); break;
+            case 1u << WAVE_SQUARE:   render_group<S>(lanes, g, acc, n, Square<S>(), ramp, filter); break;
+            case 1u << WAVE_SAW:      render_group<S>(lanes, g, acc, n, Saw<S>(), ramp, filter); break;
+            case 1u << WAVE_TRIANGLE: render_group<S>(lanes, g, acc, n, Triangle<S>(), ramp, filter); break;
+            case 1u << WAVE_PULSE:    render_group<S>(lanes, g, acc, n, Pulse<S>(), ramp, filter); break;
+            default: {
+                Mixed<S> mixed;
+                mixed.present = present;
+                for (int w = 0; w < WAVE_COUNT; ++w) {
+                    alignas(64) float weight[S::width];
+                    for (int i = 0; i < S::width; ++i) {
+                        weight[i] = lanes.waveform[g + i] == w ? 1.0f : 0.0f;
+                    }
+                    mixed.weight[w] = S::load(weight);
+                }
+                render_group<S>(lanes, g, acc, n, mixed, ramp, filter);
+                break;
+            }
+        }
+    }
+
+    if (!any) {
+        return;
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        out[i] += S::hsum(S::load(acc + i * S::width));
+    }
+}
+
+// Scale the mono voice sum by a gain ramping linearly from gain by
+// gain_increment per frame and write it to both output channels. A flat gain
+// takes the same single multiply as before.
+template <class S>
+void mix_stereo(const float* in, float gain, float gain_increment,
+                float* left, float* right, uint32_t n) {
+    using V = typename S::V;
+    uint32_t i = 0;
+
+    if (gain_increment == 0.0f) {
+        const V g = S::set1(gain);
+        for (; i + S::width <= n; i += S::width) {
+            const V sample = S::mul(S::loadu(in + i), g);
+            S::storeu(left + i, sample);
+            S::storeu(right + i, sample);
+        }
+    } else {
+        alignas(64) float ramp[S::width];
+        for (int lane = 0; lane < S::width; ++lane) {
+            ramp[lane] = gain + gain_increment * lane;
+        }
+        V g = S::load(ramp);
+        const V step = S::set1(gain_increment * S::width);
+        for (; i + S::width <= n; i += S::width) {
+            const V sample = S::mul(S::loadu(in + i), g);
+            S::storeu(left + i, sample);
+            S::storeu(right + i, sample);
+            g = S::add(g, step);
+        }
+    }
+
+    for (; i < n; ++i) {
+        left[i] = in[i] * (gain + gain_increment * i);
+        right[i] = left[i];
+    }
+}
+
+} // namespace voice_kernels
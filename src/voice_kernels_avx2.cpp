@@ -0,0 +1,25 @@
+// Compiled with AVX2 enabled, only called when the CPU supports it
+#define SIMD_NAMESPACE simd_avx2
+#include "dsp_dispatch.h"
+#include "voice_kernels.h"
+
+namespace {
+
+using S = simd_avx2::SimdAVX2;
+
+void render_voices(VoiceLanes& lanes, int lane_count, float* out, uint32_t n) {
+    voice_kernels::render_lanes<S>(lanes, lane_count, out, n);
+}
+
+void mix_stereo(const float* in, float gain, float gain_increment,
+                float* left, float* right, uint32_t n) {
+    voice_kernels::mix_stereo<S>(in, gain, gain_increment, left, right, n);
+}
+
+} // namespace
+
+extern const DspKernels dsp_kernels_avx2 = {
+    "AVX2",
+    render_voices,
+    mix_stereo
+};
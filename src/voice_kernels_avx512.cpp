@@ -0,0 +1,34 @@
+// Compiled with AVX-512F enabled, only called when the CPU supports it
+
+// GCC 12 flags the _mm512_undefined_*() passthrough inside many unmasked
+// AVX-512 intrinsics as (maybe) uninitialized at every inlined use. It is
+// undefined on purpose, the instructions overwrite every lane.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+#define SIMD_NAMESPACE simd_avx512
+#include "dsp_dispatch.h"
+#include "voice_kernels.h"
+
+namespace {
+
+using S = simd_avx512::SimdAVX512;
+
+void render_voices(VoiceLanes& lanes, int lane_count, float* out, uint32_t n) {
+    voice_kernels::render_lanes<S>(lanes, lane_count, out, n);
+}
+
+void mix_stereo(const float* in, float gain, float gain_increment,
+                float* left, float* right, uint32_t n) {
+    voice_kernels::mix_stereo<S>(in, gain, gain_increment, left, right, n);
+}
+
+} // namespace
+
+extern const DspKernels dsp_kernels_avx512 = {
+    "AVX-512",
+    render_voices,
+    mix_stereo
+};
@@ -0,0 +1,25 @@
+// Baseline kernels: SSE2 on x86-64, scalar elsewhere
+#define SIMD_NAMESPACE simd_generic
+#include "dsp_dispatch.h"
+#include "voice_kernels.h"
+
+namespace {
+
+using S = simd_generic::SimdNative;
+
+void render_voices(VoiceLanes& lanes, int lane_count, float* out, uint32_t n) {
+    voice_kernels::render_lanes<S>(lanes, lane_count, out, n);
+}
+
+void mix_stereo(const float* in, float gain, float gain_increment,
+                float* left, float* right, uint32_t n) {
+    voice_kernels::mix_stereo<S>(in, gain, gain_increment, left, right, n);
+}
+
+} // namespace
+
+extern const DspKernels dsp_kernels_generic = {
+    "Generic",
+    render_voices,
+    mix_stereo
+};
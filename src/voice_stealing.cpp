@@ -0,0 +1,98 @@
+#include "voice_stealing.h"
+
+StealQueue::StealQueue() {
+    clear();
+}
+
+void StealQueue::clear() {
+    for (int slot = 0; slot < MAX_SLOTS; ++slot) {
+        keys_[slot] = StealKey{0, 0};
+        heap_[slot] = -1;
+        positions_[slot] = -1;
+    }
+    size_ = 0;
+}
+
+void StealQueue::update(int slot, StealKey key) {
+    int position = positions_[slot];
+    if (position < 0) {
+        position = size_++;
+        place(position, slot);
+        keys_[slot] = key;
+        sift_up(position);
+        return;
+    }
+
+    const StealKey old_key = keys_[slot];
+    keys_[slot] = key;
+    if (key < old_key) {
+        sift_up(position);
+    } else {
+        sift_down(position);
+    }
+}
+
+void StealQueue::remove(int slot) {
+    const int position = positions_[slot];
+    if (position < 0) {
+        return;
+    }
+    positions_[slot] = -1;
+
+    // Fill the gap with the last entry and restore the heap around it
+    const int last = heap_[--size_];
+    heap_[size_] = -1;
+    if (position == size_) {
+        return;
+    }
+    place(position, last);
+    sift_up(position);
+    sift_down(positions_[last]);
+}
+
+void StealQueue::move(int from, int to) {
+    const int position = positions_[from];
+    if (position < 0) {
+        return;
+    }
+    keys_[to] = keys_[from];
+    positions_[from] = -1;
+    place(position, to);
+}
+
+void StealQueue::place(int position, int slot) {
+    heap_[position] = static_cast<int16_t>(slot);
+    positions_[slot] = static_cast<int16_t>(position);
+}
+
+void StealQueue::sift_up(int position) {
+    const int slot = heap_[position];
+    while (position > 0) {
+        const int parent = (position - 1) / 2;
+        if (!(keys_[slot] < keys_[heap_[parent]])) {
+            break;
+        }
+        place(position, heap_[parent]);
+        position = parent;
+    }
+    place(position, slot);
+}
+
+void StealQueue::sift_down(int position) {
+    const int slot = heap_[position];
+    for (;;) {
+        int child = 2 * position + 1;
+        if (child >= size_) {
+            break;
+        }
+        if (child + 1 < size_ && keys_[heap_[child + 1]] < keys_[heap_[child]]) {
+            ++child;
+        }
+        if (!(keys_[heap_[child]] < keys_[slot])) {
+            break;
+        }
+        place(position, heap_[child]);
+        position = child;
+    }
+    place(position, slot);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+// Which voice gives way when a note arrives and every voice is sounding
+enum StealPolicy {
+    STEAL_OLDEST = 0,       // Longest running note
+    STEAL_QUIETEST,         // Lowest level the envelope is heading for
+    STEAL_RELEASED_FIRST,   // Released notes closest to their end, then the oldest
+    STEAL_SAME_NOTE,        // A voice already playing the key, else released first
+    STEAL_POLICY_COUNT
+};
+
+// Ordered by level first, then by order. Both halves are full 64-bit values
+// so sample clocks used as tie-breaks never wrap within a session.
+struct StealKey {
+    uint64_t level;
+    uint64_t order;
+
+    bool operator<(const StealKey& other) const {
+        return level != other.level ? level < other.level : order < other.order;
+    }
+};
+
+// Min-heap of voice slots ordered by a steal key, so the victim is always at
+// the top. Keys only change when a voice starts, is released or reaches an
+// envelope stage boundary, which keeps every update O(log n). Fixed size,
+// nothing allocates.
+class StealQueue {
+public:
+    static constexpr int MAX_SLOTS = 512;
+
+    StealQueue();
+
+    void clear();
+
+    // Insert slot or change its key
+    void update(int slot, StealKey key);
+    void remove(int slot);
+    // The voice in slot from now lives in slot to (which must be unused)
+    void move(int from, int to);
+
+    bool empty() const { return size_ == 0; }
+    // Slot with the smallest key
+    int top() const { return heap_[0]; }
+
+private:
+    StealKey keys_[MAX_SLOTS];
+    int16_t heap_[MAX_SLOTS];
+    int16_t positions_[MAX_SLOTS];   // Index into heap_, -1 if not queued
+    int size_;
+
+    void place(int position, int slot);
+    void sift_up(int position);
+    void sift_down(int position);
+};
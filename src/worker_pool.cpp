@@ -0,0 +1,351 @@
+#include "worker_pool.h"
+#include <algorithm>
+#include <chrono>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <pthread.h>
+#endif
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#endif
+#if defined(__unix__) && !defined(__APPLE__)
+#include <cerrno>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+uint64_t pack_range(uint32_t front, uint32_t back) {
+    return (static_cast<uint64_t>(front) << 32) | back;
+}
+
+uint32_t range_front(uint64_t range) { return static_cast<uint32_t>(range >> 32); }
+uint32_t range_back(uint64_t range) { return static_cast<uint32_t>(range); }
+
+void cpu_relax() {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void pin_current_thread(int core) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    // No hard affinity on macOS; the scheduler keeps the threads apart
+    (void)core;
+#endif
+}
+
+} // namespace
+
+#if defined(__APPLE__)
+WorkerPool::Semaphore::Semaphore() : semaphore_(dispatch_semaphore_create(0)) {}
+WorkerPool::Semaphore::~Semaphore() { dispatch_release(semaphore_); }
+
+void WorkerPool::Semaphore::post() {
+    dispatch_semaphore_signal(semaphore_);
+}
+
+void WorkerPool::Semaphore::wait() {
+    dispatch_semaphore_wait(semaphore_, DISPATCH_TIME_FOREVER);
+}
+#elif defined(__unix__)
+WorkerPool::Semaphore::Semaphore() { sem_init(&semaphore_, 0, 0); }
+WorkerPool::Semaphore::~Semaphore() { sem_destroy(&semaphore_); }
+
+void WorkerPool::Semaphore::post() {
+    sem_post(&semaphore_);
+}
+
+void WorkerPool::Semaphore::wait() {
+    while (sem_wait(&semaphore_) != 0 && errno == EINTR) {
+    }
+}
+#else
+WorkerPool::Semaphore::Semaphore() : count_(0) {}
+WorkerPool::Semaphore::~Semaphore() = default;
+
+void WorkerPool::Semaphore::post() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++count_;
+    }
+    condition_.notify_one();
+}
+
+void WorkerPool::Semaphore::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this] { return count_ > 0; });
+    --count_;
+}
+#endif
+
+WorkerPool::ThreadPriority WorkerPool::current_thread_priority() {
+    ThreadPriority priority{};
+#if defined(__APPLE__)
+    mach_msg_type_number_t count = THREAD_TIME_CONSTRAINT_POLICY_COUNT;
+    boolean_t get_default = false;
+    const kern_return_t result = thread_policy_get(
+        pthread_mach_thread_np(pthread_self()), THREAD_TIME_CONSTRAINT_POLICY,
+        reinterpret_cast<thread_policy_t>(&priority.policy), &count, &get_default);
+    priority.time_constraint = result == KERN_SUCCESS && !get_default;
+#elif defined(__unix__)
+    // Plain syscalls, safe on the audio thread
+    priority.policy = sched_getscheduler(0);
+    if (priority.policy < 0 || sched_getparam(0, &priority.param) != 0) {
+        priority.policy = SCHED_OTHER;
+    }
+#endif
+    return priority;
+}
+
+bool WorkerPool::apply_thread_priority(const ThreadPriority& priority) {
+#if defined(__APPLE__)
+    if (!priority.time_constraint) {
+        return true;
+    }
+    thread_time_constraint_policy_data_t policy = priority.policy;
+    return thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_TIME_CONSTRAINT_POLICY,
+                             reinterpret_cast<thread_policy_t>(&policy),
+                             THREAD_TIME_CONSTRAINT_POLICY_COUNT) == KERN_SUCCESS;
+#elif defined(__unix__)
+    if (priority.policy != SCHED_FIFO && priority.policy != SCHED_RR) {
+        return true;
+    }
+    return pthread_setschedparam(pthread_self(), priority.policy, &priority.param) == 0;
+#else
+    (void)priority;
+    return false;
+#endif
+}
+
+WorkerPool::WorkerPool()
+    : worker_count_(0)
+    , pinned_(false)
+    , audio_priority_{}
+    , audio_priority_known_(false)
+    , matched_workers_(0)
+    , function_(nullptr)
+    , context_(nullptr)
+    , generation_(0)
+    , pending_(0)
+    , busy_ns_(0)
+    , running_(false)
+    , last_utilization_(0.0f)
+    , run_count_(0)
+    , utilization_sum_(0.0)
+{
+}
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+void WorkerPool::start(int worker_count, bool pin_to_cores) {
+    stop();
+
+    worker_count_ = std::clamp(worker_count, 0, MAX_WORKERS);
+    pinned_ = pin_to_cores && worker_count_ > 0;
+    last_utilization_.store(0.0f);
+    run_count_.store(0);
+    utilization_sum_.store(0.0);
+    for (Parking& parking : parking_) {
+        parking.parked.store(false);
+    }
+    audio_priority_known_.store(false);
+    matched_workers_.store(0);
+    running_.store(true);
+
+    // The audio thread is participant 0, workers take the cores after it
+    const int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int i = 0; i < worker_count_; ++i) {
+        const int core = pin_to_cores ? (i + 1) % cores : -1;
+        threads_[i] = std::thread(&WorkerPool::worker_main, this, i + 1, core);
+    }
+}
+
+void WorkerPool::stop() {
+    if (!running_.load()) {
+        return;
+    }
+
+    // A token left over only causes a spurious wakeup after the next start()
+    running_.store(false);
+    for (int i = 0; i < worker_count_; ++i) {
+        parking_[i].wake.post();
+    }
+    for (int i = 0; i < worker_count_; ++i) {
+        threads_[i].join();
+    }
+    worker_count_ = 0;
+    pinned_ = false;
+}
+
+void WorkerPool::run(int task_count, TaskFunction function, void* context) {
+    if (task_count <= 0) {
+        return;
+    }
+    if (worker_count_ == 0 || task_count == 1) {
+        for (int task = 0; task < task_count; ++task) {
+            function(context, task);
+        }
+        return;
+    }
+
+    // Once per start(); published to the workers by the generation_ bump
+    if (!audio_priority_known_.load(std::memory_order_relaxed)) {
+        audio_priority_ = current_thread_priority();
+        audio_priority_known_.store(true);
+    }
+
+    const uint64_t start = now_ns();
+    const int participants = std::min(task_count, worker_count_ + 1);
+    function_ = function;
+    context_ = context;
+    busy_ns_.store(0);
+    pending_.store(task_count);
+    for (int p = 0; p < MAX_PARTICIPANTS; ++p) {
+        const uint32_t front = p < participants ? static_cast<uint32_t>(task_count * p / participants) : 0;
+        const uint32_t back = p < participants ? static_cast<uint32_t>(task_count * (p + 1) / participants) : 0;
+        ranges_[p].range.store(pack_range(front, back));
+    }
+    generation_.fetch_add(1);
+
+    // A parking worker raises its flag before its last look at generation_,
+    // and we bumped generation_ before looking at the flags, so either it
+    // sees this run or we post it a token
+    for (int i = 0; i < worker_count_; ++i) {
+        if (parking_[i].parked.load() && parking_[i].parked.exchange(false)) {
+            parking_[i].wake.post();
+        }
+    }
+
+    // Unclaimed tasks are all stolen in participate(); what is left are
+    // tasks other participants are running. A worker we could not raise to
+    // our priority may be preempted in one, so give up the core then.
+    participate(0);
+    const bool spin = matched_workers_.load(std::memory_order_relaxed) == worker_count_;
+    while (pending_.load() > 0) {
+        if (spin) {
+            cpu_relax();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    const uint64_t wall = std::max<uint64_t>(1, now_ns() - start);
+    const float utilization = static_cast<float>(
+        static_cast<double>(busy_ns_.load()) / (static_cast<double>(wall) * participants));
+    last_utilization_.store(utilization, std::memory_order_relaxed);
+    utilization_sum_.store(utilization_sum_.load(std::memory_order_relaxed) + utilization,
+                           std::memory_order_relaxed);
+    run_count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+float WorkerPool::average_utilization() const {
+    const uint64_t runs = run_count_.load(std::memory_order_relaxed);
+    if (runs == 0) {
+        return 0.0f;
+    }
+    return static_cast<float>(utilization_sum_.load(std::memory_order_relaxed) / runs);
+}
+
+void WorkerPool::worker_main(int participant, int core) {
+    if (core >= 0) {
+        pin_current_thread(core);
+    }
+
+    bool priority_applied = false;
+    uint64_t seen = generation_.load();
+    while (running_.load()) {
+        // Spin first so the next block finds us awake, then park
+        const uint64_t spin_start = now_ns();
+        while (generation_.load() == seen && running_.load() && now_ns() - spin_start < SPIN_NANOSECONDS) {
+            cpu_relax();
+        }
+        if (generation_.load() == seen) {
+            // If run() has already moved on we skip the wait, and the token
+            // it may still post us later only costs one spurious wakeup
+            Parking& parking = parking_[participant - 1];
+            parking.parked.store(true);
+            if (generation_.load() == seen && running_.load()) {
+                parking.wake.wait();
+            }
+            continue;
+        }
+
+        seen = generation_.load();
+        if (!priority_applied && audio_priority_known_.load()) {
+            priority_applied = true;
+            if (apply_thread_priority(audio_priority_)) {
+                matched_workers_.fetch_add(1);
+            }
+        }
+        // With fewer tasks than threads our own range is empty and we only
+        // steal
+        participate(participant);
+    }
+}
+
+void WorkerPool::participate(int participant) {
+    int task = take_own(participant);
+    if (task < 0) {
+        task = steal(participant);
+    }
+    while (task >= 0) {
+        // Account before completing, run() reads the total once pending_
+        // drops to zero
+        const uint64_t start = now_ns();
+        function_(context_, task);
+        busy_ns_.fetch_add(now_ns() - start);
+        pending_.fetch_sub(1);
+
+        task = take_own(participant);
+        if (task < 0) {
+            task = steal(participant);
+        }
+    }
+}
+
+int WorkerPool::take_own(int participant) {
+    if (participant >= MAX_PARTICIPANTS) {
+        return -1;
+    }
+    std::atomic<uint64_t>& range = ranges_[participant].range;
+    uint64_t current = range.load();
+    while (range_front(current) < range_back(current)) {
+        const uint32_t back = range_back(current) - 1;
+        if (range.compare_exchange_weak(current, pack_range(range_front(current), back))) {
+            return static_cast<int>(back);
+        }
+    }
+    return -1;
+}
+
+int WorkerPool::steal(int participant) {
+    for (int offset = 1; offset < MAX_PARTICIPANTS; ++offset) {
+        std::atomic<uint64_t>& range = ranges_[(participant + offset) % MAX_PARTICIPANTS].range;
+        uint64_t current = range.load();
+        while (range_front(current) < range_back(current)) {
+            const uint32_t front = range_front(current);
+            if (range.compare_exchange_weak(current, pack_range(front + 1, range_back(current)))) {
+                return static_cast<int>(front);
+            }
+        }
+    }
+    return -1;
+}
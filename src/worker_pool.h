@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#include <mach/thread_policy.h>
+#elif defined(__unix__)
+#include <sched.h>
+#include <semaphore.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+// Real-time worker threads for hosts without clap.thread-pool. Threads are
+// created by start() (from activate()) and joined by stop(); run() is called
+// from the audio thread and never allocates or takes a lock.
+//
+// Each run() splits the tasks into contiguous ranges, one per participant
+// (the calling thread is participant 0). A participant takes tasks from the
+// back of its own range and, once that is empty, steals from the front of
+// the others. Between runs the workers spin for a short while so back to back
+// blocks find them awake, then park on a semaphore.
+//
+// The first run() records the audio thread's scheduling class (SCHED_FIFO/RR
+// on Linux, the time-constraint policy on macOS) and every worker copies it
+// before its first task. Where that is refused, e.g. without an rtprio
+// limit, the pool is best effort: a preempted worker can hold up run() until
+// its current task finishes, so run() yields rather than spins while it
+// waits.
+class WorkerPool {
+public:
+    static constexpr int MAX_WORKERS = 15;
+
+    using TaskFunction = void (*)(void* context, int task);
+
+    WorkerPool();
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Launch worker_count threads (clamped to MAX_WORKERS), optionally pinned
+    // to one core each. Main thread only.
+    void start(int worker_count, bool pin_to_cores);
+    void stop();
+    int worker_count() const { return worker_count_; }
+    bool pinned() const { return pinned_; }
+
+    // Run function(context, task) for every task in [0, task_count) and
+    // return once all of them are done. Audio thread only.
+    void run(int task_count, TaskFunction function, void* context);
+
+    // Share of the last run()'s wall time the participants spent in tasks
+    // (1 means nobody waited), and the average over all runs since start()
+    float last_utilization() const { return last_utilization_.load(std::memory_order_relaxed); }
+    float average_utilization() const;
+    uint64_t run_count() const { return run_count_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int MAX_PARTICIPANTS = MAX_WORKERS + 1;
+    // Polling before a worker parks. Bounded by the clock, a pause
+    // instruction takes anywhere from ~10 to ~140 cycles depending on the CPU.
+    static constexpr uint64_t SPIN_NANOSECONDS = 50000;
+
+    // Remaining tasks of one participant as [front, back), packed in one
+    // word so the owner and the thieves agree through a single CAS
+    struct alignas(64) TaskRange {
+        std::atomic<uint64_t> range{0};
+    };
+
+    std::thread threads_[MAX_WORKERS];
+    int worker_count_;
+    bool pinned_;
+    TaskRange ranges_[MAX_PARTICIPANTS];
+
+    // Scheduling class of the thread calling run()
+    struct ThreadPriority {
+#if defined(__APPLE__)
+        bool time_constraint;
+        thread_time_constraint_policy_data_t policy;
+#elif defined(__unix__)
+        int policy;
+        sched_param param;
+#endif
+    };
+    ThreadPriority audio_priority_;
+    std::atomic<bool> audio_priority_known_;
+    // Workers running at audio_priority_ (or with nothing to match)
+    std::atomic<int> matched_workers_;
+
+    // Current run, published by bumping generation_
+    TaskFunction function_;
+    void* context_;
+    alignas(64) std::atomic<uint64_t> generation_;
+    alignas(64) std::atomic<int> pending_;
+    alignas(64) std::atomic<uint64_t> busy_ns_;
+    std::atomic<bool> running_;
+
+    // Parking. A semaphore keeps a wakeup posted before the worker gets to
+    // wait; posting it never blocks the audio thread. One per worker, so a
+    // worker that parks again quickly cannot take another one's wakeup.
+    class Semaphore {
+    public:
+        Semaphore();
+        ~Semaphore();
+        void post();
+        void wait();
+
+    private:
+#if defined(__APPLE__)
+        dispatch_semaphore_t semaphore_;
+#elif defined(__unix__)
+        sem_t semaphore_;
+#else
+        std::mutex mutex_;
+        std::condition_variable condition_;
+        int count_;
+#endif
+    };
+    struct alignas(64) Parking {
+        Semaphore wake;
+        std::atomic<bool> parked{false};
+    };
+    Parking parking_[MAX_WORKERS];
+
+    // Utilization
+    std::atomic<float> last_utilization_;
+    std::atomic<uint64_t> run_count_;
+    std::atomic<double> utilization_sum_;
+
+    static ThreadPriority current_thread_priority();
+    static bool apply_thread_priority(const ThreadPriority& priority);
+
+    void worker_main(int participant, int core);
+    void participate(int participant);
+    int take_own(int participant);
+    int steal(int participant);
+};
@@ -0,0 +1,45 @@
+// Checks the polynomial sine used by the voice kernels against std::sin.
+// Build: clang++ -std=c++17 -O2 -Isrc test_fast_sine.cpp -o test_fast_sine
+#include <iostream>
+#include <cmath>
+#include "simd.h"
+#include "fast_sine.h"
+
+using namespace simd_generic;
+
+template <class S>
+static double max_error() {
+    const int steps = 1 << 20;
+    double max_err = 0.0;
+    alignas(64) float phase[S::width];
+    alignas(64) float result[S::width];
+
+    for (int i = 0; i <= steps; i += S::width) {
+        for (int lane = 0; lane < S::width; ++lane) {
+            phase[lane] = static_cast<float>(std::min(i + lane, steps)) / steps;
+        }
+        S::store(result, fast_sine<S>(S::load(phase)));
+        for (int lane = 0; lane < S::width; ++lane) {
+            const double expected = std::sin(2.0 * M_PI * static_cast<double>(phase[lane]));
+            max_err = std::max(max_err, std::fabs(result[lane] - expected));
+        }
+    }
+    return max_err;
+}
+
+int main() {
+    const double bound = 3e-7;
+
+    const double scalar_err = max_error<SimdScalar>();
+    const double native_err = max_error<SimdNative>();
+    std::cout << "fast_sine max error (scalar): " << scalar_err << std::endl;
+    std::cout << "fast_sine max error (" << SimdNative::width << " lanes): " << native_err << std::endl;
+
+    if (scalar_err > bound || native_err > bound) {
+        std::cerr << "fast_sine exceeds error bound " << bound << std::endl;
+        return 1;
+    }
+
+    std::cout << "Fast sine test completed successfully!" << std::endl;
+    return 0;
+}
@@ -0,0 +1,138 @@
+// Round-trips a patch through the clap.state blob and feeds load() broken
+// states, which it has to refuse without touching the patch.
+// Build: clang++ -std=c++17 -O2 -Isrc -Iclap/include test_plugin_state.cpp src/plugin_state.cpp -o test_plugin_state
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "plugin_state.h"
+
+// In-memory streams; chunk limits how many bytes one call moves
+struct MemoryStream {
+    std::vector<uint8_t> data;
+    size_t position = 0;
+    uint32_t chunk = 0;
+};
+
+static int64_t memory_write(const clap_ostream_t* stream, const void* buffer, uint64_t size) {
+    MemoryStream& memory = *static_cast<MemoryStream*>(stream->ctx);
+    const uint8_t* bytes = static_cast<const uint8_t*>(buffer);
+    memory.data.insert(memory.data.end(), bytes, bytes + size);
+    return static_cast<int64_t>(size);
+}
+
+static int64_t memory_read(const clap_istream_t* stream, void* buffer, uint64_t size) {
+    MemoryStream& memory = *static_cast<MemoryStream*>(stream->ctx);
+    uint64_t count = std::min<uint64_t>(size, memory.data.size() - memory.position);
+    if (memory.chunk > 0) {
+        count = std::min<uint64_t>(count, memory.chunk);
+    }
+    std::memcpy(buffer, memory.data.data() + memory.position, count);
+    memory.position += count;
+    return static_cast<int64_t>(count);
+}
+
+static std::vector<uint8_t> save(const Patch& patch) {
+    MemoryStream memory;
+    const clap_ostream_t stream = {&memory, memory_write};
+    if (!plugin_state::save(&stream, patch)) {
+        std::cerr << "save failed" << std::endl;
+    }
+    return memory.data;
+}
+
+static bool load(const std::vector<uint8_t>& data, Patch* patch, uint32_t chunk = 0) {
+    MemoryStream memory;
+    memory.data = data;
+    memory.chunk = chunk;
+    const clap_istream_t stream = {&memory, memory_read};
+    return plugin_state::load(&stream, patch);
+}
+
+static void put_u32(std::vector<uint8_t>& data, size_t offset, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        data[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+static bool same_values(const Patch& a, const Patch& b) {
+    for (clap_id param_id = 0; param_id < PARAM_COUNT; ++param_id) {
+        if (a.value(static_cast<ParamId>(param_id)) != b.value(static_cast<ParamId>(param_id))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::cout << (condition ? "ok      " : "FAILED  ") << what << std::endl;
+    if (!condition) {
+        ++failures;
+    }
+}
+
+int main() {
+    // Something other than the defaults in every parameter
+    Patch patch;
+    for (clap_id param_id = 0; param_id < PARAM_COUNT; ++param_id) {
+        const ParamDescriptor& param = PARAMS[param_id];
+        patch.set_value(param.id, param.min_value + 0.75 * (param.max_value - param.min_value));
+    }
+    const Patch defaults;
+
+    const std::vector<uint8_t> blob = save(patch);
+    check(blob.size() == 12 + 12 * PARAM_COUNT, "blob holds a header and one record per parameter");
+    check(std::memcmp(blob.data(), "SSYN", 4) == 0 && blob[4] == plugin_state::STATE_VERSION
+              && blob[5] == 0 && blob[8] == PARAM_COUNT && blob[9] == 0,
+          "header is magic, then little-endian version and count");
+
+    Patch loaded;
+    check(load(blob, &loaded) && same_values(loaded, patch), "save then load round-trips every value");
+
+    loaded = Patch();
+    check(load(blob, &loaded, 1) && same_values(loaded, patch), "load copes with one byte per read");
+
+    bool truncated_refused = true;
+    for (size_t size = 0; size < blob.size(); ++size) {
+        Patch untouched;
+        const std::vector<uint8_t> truncated(blob.begin(), blob.begin() + static_cast<std::ptrdiff_t>(size));
+        truncated_refused = truncated_refused && !load(truncated, &untouched) && same_values(untouched, defaults);
+    }
+    check(truncated_refused, "every truncated blob is refused and leaves the patch alone");
+
+    std::vector<uint8_t> bad_magic = blob;
+    bad_magic[0] = 'X';
+    Patch untouched;
+    check(!load(bad_magic, &untouched) && same_values(untouched, defaults), "bad magic is refused");
+
+    std::vector<uint8_t> newer = blob;
+    put_u32(newer, 4, plugin_state::STATE_VERSION + 1);
+    check(!load(newer, &untouched) && same_values(untouched, defaults), "a newer version is refused");
+
+    std::vector<uint8_t> oversized = blob;
+    put_u32(oversized, 8, plugin_state::MAX_RECORDS + 1);
+    oversized.resize(12 + 12 * static_cast<size_t>(plugin_state::MAX_RECORDS + 1));
+    check(!load(oversized, &untouched) && same_values(untouched, defaults), "a count above MAX_RECORDS is refused");
+
+    // The first record renamed to an id from a newer build; only that
+    // parameter stays at its default
+    std::vector<uint8_t> unknown = blob;
+    put_u32(unknown, 12, PARAM_COUNT + 100);
+    loaded = Patch();
+    bool others_loaded = load(unknown, &loaded);
+    for (clap_id param_id = 0; param_id < PARAM_COUNT; ++param_id) {
+        const ParamId id = static_cast<ParamId>(param_id);
+        const double expected = param_id == 0 ? defaults.value(id) : patch.value(id);
+        others_loaded = others_loaded && loaded.value(id) == expected;
+    }
+    check(others_loaded, "an unknown id is skipped and the other records load");
+
+    if (failures > 0) {
+        std::cerr << failures << " plugin state checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Plugin state test completed successfully!" << std::endl;
+    return 0;
+}
@@ -0,0 +1,111 @@
+// Fills a small voice bank and checks which voice each steal policy gives up.
+// Build: clang++ -std=c++17 -O2 -Isrc test_voice_stealing.cpp src/voice_bank.cpp src/voice.cpp src/note_index.cpp src/note_table.cpp src/voice_stealing.cpp src/dsp_dispatch.cpp src/voice_kernels_generic.cpp -o test_voice_stealing
+#include <iostream>
+#include <vector>
+#include "note_table.h"
+#include "voice_bank.h"
+
+static constexpr double SAMPLE_RATE = 48000.0;
+static constexpr uint32_t BLOCK = 256;
+
+static NoteTable notes;
+static std::vector<float> out(BLOCK);
+
+static NoteKey key_of(int key) {
+    NoteKey note;
+    note.port = 0;
+    note.channel = 0;
+    note.key = static_cast<int16_t>(key);
+    return note;
+}
+
+// Fast attack and a long decay to zero sustain, so held notes head for
+// silence just like released ones
+static void start(VoiceBank& bank, int key, double release) {
+    Voice* voice = bank.allocate();
+    voice->set_adsr(0.001, 2.0, 0.0, release);
+    voice->note_on(key, 1.0, notes);
+    bank.assign_note(voice, key_of(key));
+}
+
+static void stop(VoiceBank& bank, int key) {
+    bank.for_each_note(key_of(key), [](Voice& voice) { voice.note_off(); });
+}
+
+static void render(VoiceBank& bank, int blocks) {
+    for (int block = 0; block < blocks; ++block) {
+        const int tasks = bank.begin_render(out.data(), BLOCK);
+        for (int task = 0; task < tasks; ++task) {
+            bank.render_task(task);
+        }
+        bank.end_render();
+    }
+}
+
+// Note of the voice a new note would take over
+static int victim(VoiceBank& bank) {
+    return bank.steal(key_of(127))->get_note();
+}
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::cout << (condition ? "ok      " : "FAILED  ") << what << std::endl;
+    if (!condition) {
+        ++failures;
+    }
+}
+
+int main() {
+    notes.set_sample_rate(SAMPLE_RATE);
+    VoiceBank bank;
+
+    // Every note past its attack and heading for zero; two of them released,
+    // the later one with the shorter release
+    bank.set_capacity(VoiceBank::MIN_VOICES, BLOCK);
+    bank.set_steal_policy(STEAL_QUIETEST);
+    start(bank, 60, 1.0);
+    start(bank, 62, 0.2);
+    start(bank, 64, 1.0);
+    start(bank, 65, 1.0);
+    render(bank, 4);
+    stop(bank, 60);
+    stop(bank, 62);
+    render(bank, 1);
+    check(victim(bank) == 62, "quietest: a level tie goes to the release ending first");
+
+    bank.set_capacity(VoiceBank::MIN_VOICES, BLOCK);
+    bank.set_steal_policy(STEAL_QUIETEST);
+    start(bank, 60, 1.0);
+    start(bank, 62, 1.0);
+    start(bank, 64, 1.0);
+    start(bank, 65, 1.0);
+    render(bank, 4);
+    stop(bank, 65);
+    check(victim(bank) == 65, "quietest: a release beats an older note still decaying");
+
+    bank.set_capacity(VoiceBank::MIN_VOICES, BLOCK);
+    bank.set_steal_policy(STEAL_QUIETEST);
+    start(bank, 60, 1.0);
+    start(bank, 62, 1.0);
+    start(bank, 64, 1.0);
+    start(bank, 65, 1.0);
+    render(bank, 4);
+    check(victim(bank) == 60, "quietest: among held notes the oldest goes");
+
+    bank.set_capacity(VoiceBank::MIN_VOICES, BLOCK);
+    bank.set_steal_policy(STEAL_OLDEST);
+    start(bank, 60, 1.0);
+    start(bank, 62, 1.0);
+    start(bank, 64, 1.0);
+    start(bank, 65, 1.0);
+    stop(bank, 64);
+    check(victim(bank) == 60, "oldest: the first note goes whatever its state");
+
+    if (failures > 0) {
+        std::cerr << failures << " voice stealing checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Voice stealing test completed successfully!" << std::endl;
+    return 0;
+}